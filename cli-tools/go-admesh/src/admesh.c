@@ -23,12 +23,44 @@
 #include <stdio.h>
 #include <getopt.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 #include "stl.h"
 #include "config.h"
 
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+/* Everything the workers of the batch mode share */
+typedef struct {
+  char  **files;
+  int     count;
+  int     next;
+  int     json;
+  int     ret;
+  int     fixall_flag;
+  int     exact_flag;
+  int     tolerance_flag;
+  float   tolerance;
+  int     increment_flag;
+  float   increment;
+  int     nearby_flag;
+  int     iterations;
+  int     remove_unconnected_flag;
+  int     fill_holes_flag;
+  int     normal_directions_flag;
+  int     normal_values_flag;
+  int     reverse_all_flag;
+#ifdef HAVE_LIBPTHREAD
+  pthread_mutex_t lock;
+#endif
+} batch_data;
+
 static void usage(int status, char *program_name);
+static int read_batch_list(char *name, char ***files, int *count);
+static int run_batch(batch_data *batch, int threads);
 
 int
 main(int argc, char **argv) {
@@ -50,6 +82,12 @@ main(int argc, char **argv) {
   char     *off_name = NULL;
   char     *dxf_name = NULL;
   char     *vrml_name = NULL;
+  char     *json_stats_name = NULL;
+  char     *parts_prefix = NULL;
+  stl_part_stats *parts;
+  int      number_of_parts;
+  int      i;
+  FILE     *json_stats_fp;
   int      fixall_flag = 1;	       /* Default behavior is to fix all. */
   int      exact_flag = 0;	       /* All checks turned off by default. */
   int      tolerance_flag = 0;	       /* Is tolerance specified on cmdline */
@@ -78,14 +116,20 @@ main(int argc, char **argv) {
   int      version_flag = 0;
 
   int      iterations = 2;	       /* Default number of iterations. */
+  int      threads = 1;
+  int      deterministic_flag = 0;
   int      increment_flag = 0;
   char     *input_file = NULL;
+  char     *batch_format = NULL;
+  char     *batch_list_name = NULL;
+  batch_data batch;
 
   int ret = 0;
 
   enum {rotate_x = 1000, rotate_y, rotate_z, merge, help, version,
         mirror_xy, mirror_yz, mirror_xz, scale, translate, reverse_all,
-        off_file, dxf_file, vrml_file
+        off_file, dxf_file, vrml_file, threads_option, deterministic,
+        batch_option, batch_list, json_stats_file, parts_file
        };
 
   struct option long_options[] = {
@@ -105,6 +149,8 @@ main(int argc, char **argv) {
     {"write-off",          required_argument, NULL, off_file},
     {"write-dxf",          required_argument, NULL, dxf_file},
     {"write-vrml",         required_argument, NULL, vrml_file},
+    {"write-json-stats",   required_argument, NULL, json_stats_file},
+    {"write-parts",        required_argument, NULL, parts_file},
     {"translate",          required_argument, NULL, translate},
     {"scale",              required_argument, NULL, scale},
     {"x-rotate",           required_argument, NULL, rotate_x},
@@ -114,6 +160,10 @@ main(int argc, char **argv) {
     {"yz-mirror",          no_argument,       NULL, mirror_yz},
     {"xz-mirror",          no_argument,       NULL, mirror_xz},
     {"merge",              required_argument, NULL, merge},
+    {"threads",            required_argument, NULL, threads_option},
+    {"deterministic",      no_argument,       NULL, deterministic},
+    {"batch",              required_argument, NULL, batch_option},
+    {"batch-list",         required_argument, NULL, batch_list},
     {"help",               no_argument,       NULL, help},
     {"version",            no_argument,       NULL, version},
     {NULL, 0, NULL, 0}
@@ -185,6 +235,12 @@ main(int argc, char **argv) {
       write_vrml_flag = 1;
       vrml_name = optarg;
       break;
+    case parts_file:
+      parts_prefix = optarg;
+      break;
+    case json_stats_file:
+      json_stats_name = optarg;
+      break;
     case dxf_file:
       write_dxf_flag = 1;
       dxf_name = optarg;
@@ -222,6 +278,18 @@ main(int argc, char **argv) {
       merge_flag = 1;
       merge_name = optarg;
       break;
+    case threads_option:
+      threads = atoi(optarg);
+      break;
+    case deterministic:
+      deterministic_flag = 1;
+      break;
+    case batch_option:
+      batch_format = optarg;
+      break;
+    case batch_list:
+      batch_list_name = optarg;
+      break;
     case help:
       help_flag = 1;
       break;
@@ -243,6 +311,50 @@ main(int argc, char **argv) {
     return 0;
   }
 
+  if(batch_format != NULL || batch_list_name != NULL) {
+    if(batch_format == NULL) batch_format = "csv";
+    if(strcmp(batch_format, "csv") != 0 && strcmp(batch_format, "json") != 0) {
+      fprintf(stderr, "Unknown batch format %s, use csv or json.\n",
+              batch_format);
+      usage(1, program_name);
+      return 1;
+    }
+    memset(&batch, 0, sizeof(batch));
+    batch.json = (strcmp(batch_format, "json") == 0);
+    batch.fixall_flag = fixall_flag;
+    batch.exact_flag = exact_flag;
+    batch.tolerance_flag = tolerance_flag;
+    batch.tolerance = tolerance;
+    batch.increment_flag = increment_flag;
+    batch.increment = increment;
+    batch.nearby_flag = nearby_flag;
+    batch.iterations = iterations;
+    batch.remove_unconnected_flag = remove_unconnected_flag;
+    batch.fill_holes_flag = fill_holes_flag;
+    batch.normal_directions_flag = normal_directions_flag;
+    batch.normal_values_flag = normal_values_flag;
+    batch.reverse_all_flag = reverse_all_flag;
+
+    /* The files on the command line come first, then the list */
+    batch.count = argc - optind;
+    batch.files = (char**)malloc(STL_MAX(1, batch.count) * sizeof(char*));
+    if(batch.files == NULL) {
+      perror("admesh");
+      return 1;
+    }
+    memcpy(batch.files, argv + optind, batch.count * sizeof(char*));
+    if(batch_list_name != NULL &&
+        !read_batch_list(batch_list_name, &batch.files, &batch.count)) {
+      free(batch.files);
+      return 1;
+    }
+    ret = run_batch(&batch, threads);
+    /* the names read from the list are ours, argv isn't */
+    for(c = argc - optind; c < batch.count; c++) free(batch.files[c]);
+    free(batch.files);
+    return ret;
+  }
+
   if(optind == argc) {
     printf("No input file name given.\n");
     usage(1, program_name);
@@ -260,6 +372,7 @@ redistribute it under certain conditions.  See the file COPYING for details.\n")
   printf("Opening %s\n", input_file);
   stl_open(&stl_in, input_file);
   stl_exit_on_error(&stl_in);
+  stl_set_threads(&stl_in, threads, deterministic_flag);
 
   if(rotate_x_flag) {
     printf("Rotating about the x axis by %f degrees...\n", rotate_x_angle);
@@ -319,7 +432,13 @@ redistribute it under certain conditions.  See the file COPYING for details.\n")
 
   if(generate_shared_vertices_flag) {
     printf("Generating shared vertices...\n");
-    stl_generate_shared_vertices(&stl_in);
+    if(fixall_flag || exact_flag || nearby_flag || remove_unconnected_flag
+        || fill_holes_flag || normal_directions_flag) {
+      stl_generate_shared_vertices(&stl_in);
+    } else {
+      /* Without a check there is no neighbors list to walk */
+      stl_weld_shared_vertices(&stl_in);
+    }
   }
 
   if(write_off_flag) {
@@ -369,8 +488,45 @@ redistribute it under certain conditions.  See the file COPYING for details.\n")
     }
   }
 
+  if(parts_prefix != NULL) {
+    if(!(fixall_flag || exact_flag || nearby_flag || remove_unconnected_flag
+         || fill_holes_flag || normal_directions_flag)) {
+      /* The parts are found through the neighbors list */
+      printf("Checking exact to find the parts...\n");
+      stl_check_facets_exact(&stl_in);
+    }
+    printf("Writing parts %s1.stl...\n", parts_prefix);
+    parts = stl_write_parts(&stl_in, parts_prefix,
+                            "Processed by ADMesh version " VERSION,
+                            &number_of_parts);
+    if (stl_in.error) {
+      stl_clear_error(&stl_in);
+      ret = 1;
+    }
+    for(i = 0; i < number_of_parts; i++) {
+      printf("Part %d: %d facets, Volume %f, Area %f\n", i + 1,
+             parts[i].number_of_facets, parts[i].volume, parts[i].area);
+      printf("  Min X = % f, Max X = % f\n", parts[i].min.x, parts[i].max.x);
+      printf("  Min Y = % f, Max Y = % f\n", parts[i].min.y, parts[i].max.y);
+      printf("  Min Z = % f, Max Z = % f\n", parts[i].min.z, parts[i].max.z);
+    }
+    free(parts);
+  }
+
   stl_stats_out(&stl_in, stdout, input_file);
 
+  if(json_stats_name != NULL) {
+    json_stats_fp = strcmp(json_stats_name, "-") == 0 ? stdout :
+                    fopen(json_stats_name, "w");
+    if(json_stats_fp == NULL) {
+      perror(json_stats_name);
+      ret = 1;
+    } else {
+      stl_stats_json_out(&stl_in, json_stats_fp, input_file);
+      if(json_stats_fp != stdout) fclose(json_stats_fp);
+    }
+  }
+
   stl_close(&stl_in);
 
   if (ret)
@@ -379,6 +535,129 @@ redistribute it under certain conditions.  See the file COPYING for details.\n")
   return ret;
 }
 
+static int
+read_batch_list(char *name, char ***files, int *count) {
+  /* Adds the file names in the file called name, one per line, to files.
+     A name of - reads the list from the standard input. */
+  FILE  *fp;
+  char   line[4096];
+  char  *file;
+  char **grown;
+  size_t length;
+  int    allocated = *count;
+
+  fp = strcmp(name, "-") == 0 ? stdin : fopen(name, "r");
+  if(fp == NULL) {
+    perror(name);
+    return 0;
+  }
+  while(fgets(line, sizeof(line), fp) != NULL) {
+    length = strcspn(line, "\r\n");
+    line[length] = '\0';
+    if(length == 0) continue;
+    if(*count == allocated) {
+      allocated = STL_MAX(256, allocated * 2);
+      grown = (char**)realloc(*files, allocated * sizeof(char*));
+      if(grown == NULL) break;
+      *files = grown;
+    }
+    file = (char*)malloc(length + 1);
+    if(file == NULL) break;
+    memcpy(file, line, length + 1);
+    (*files)[(*count)++] = file;
+  }
+  if(ferror(fp) || !feof(fp)) {
+    perror(name);
+    if(fp != stdin) fclose(fp);
+    return 0;
+  }
+  if(fp != stdin) fclose(fp);
+  return 1;
+}
+
+static void
+batch_lock(batch_data *batch) {
+#ifdef HAVE_LIBPTHREAD
+  pthread_mutex_lock(&batch->lock);
+#endif
+}
+
+static void
+batch_unlock(batch_data *batch) {
+#ifdef HAVE_LIBPTHREAD
+  pthread_mutex_unlock(&batch->lock);
+#endif
+}
+
+static void
+batch_worker(stl_file *pool, void *data, int thread, int threads) {
+  /* Takes the next file until there are none left.  Every worker has its
+     own stl and reads every file into the same facet lists. */
+  batch_data *batch = (batch_data*)data;
+  stl_file    stl;
+  int         i;
+
+  (void)pool;
+  (void)thread;
+  (void)threads;
+  stl_initialize(&stl);
+  for(;;) {
+    batch_lock(batch);
+    i = batch->next++;
+    batch_unlock(batch);
+    if(i >= batch->count) break;
+
+    stl_reopen(&stl, batch->files[i]);
+    stl_repair(&stl,
+               batch->fixall_flag,
+               batch->exact_flag,
+               batch->tolerance_flag,
+               batch->tolerance,
+               batch->increment_flag,
+               batch->increment,
+               batch->nearby_flag,
+               batch->iterations,
+               batch->remove_unconnected_flag,
+               batch->fill_holes_flag,
+               batch->normal_directions_flag,
+               batch->normal_values_flag,
+               batch->reverse_all_flag,
+               0);
+
+    batch_lock(batch);
+    if(batch->json) {
+      stl_stats_json_out(&stl, stdout, batch->files[i]);
+    } else {
+      stl_stats_csv_out(&stl, stdout, batch->files[i]);
+    }
+    fflush(stdout);
+    if(stl.error) batch->ret = 1;
+    batch_unlock(batch);
+    stl_clear_error(&stl);
+  }
+  stl_close(&stl);
+}
+
+static int
+run_batch(batch_data *batch, int threads) {
+  /* Repairs every file and writes one line of statistics for each, in the
+     order they are done.  There are threads workers, each file is repaired
+     on one thread. */
+  stl_file pool;
+
+  stl_initialize(&pool);
+  stl_set_threads(&pool, STL_MIN(threads, STL_MAX(1, batch->count)), 0);
+#ifdef HAVE_LIBPTHREAD
+  pthread_mutex_init(&batch->lock, NULL);
+#endif
+  if(!batch->json) stl_stats_csv_header(stdout);
+  stl_parallel_run(&pool, batch_worker, batch);
+#ifdef HAVE_LIBPTHREAD
+  pthread_mutex_destroy(&batch->lock);
+#endif
+  return batch->ret;
+}
+
 static void
 usage(int status, char *program_name) {
   if(status != 0) {
@@ -388,6 +667,7 @@ usage(int status, char *program_name) {
     printf("ADMesh version " VERSION "\n");
     printf("Copyright (C) 1995, 1996  Anthony D. Martin\n");
     printf("Usage: %s [OPTION]... file\n", program_name);
+    printf("       %s --batch=csv|json [OPTION]... file...\n", program_name);
     printf("\n");
     printf("     --x-rotate=angle     Rotate CCW about x-axis by angle degrees\n");
     printf("     --y-rotate=angle     Rotate CCW about y-axis by angle degrees\n");
@@ -414,6 +694,17 @@ usage(int status, char *program_name) {
     printf("     --write-off=name     Output a Geomview OFF format file called name\n");
     printf("     --write-dxf=name     Output a DXF format file called name\n");
     printf("     --write-vrml=name    Output a VRML format file called name\n");
+    printf("     --write-parts=prefix Output every part as a binary STL file called\n");
+    printf("                          prefix followed by its number and .stl\n");
+    printf("     --write-json-stats=name  Output the statistics with the timings of\n");
+    printf("                          the checks as one JSON object (- for stdout)\n");
+    printf("     --threads=n          Use n threads for the checks that can run in parallel\n");
+    printf("     --deterministic      Sum the statistics in the same order with any number\n");
+    printf("                          of threads, so the results are the same\n");
+    printf("     --batch=csv|json     Repair every file given and only print one line of\n");
+    printf("                          statistics per file, on --threads=n workers\n");
+    printf("     --batch-list=name    Also repair the files listed in name, one per line\n");
+    printf("                          (- for the standard input), implies --batch=csv\n");
     printf("     --help               Display this help and exit\n");
     printf("     --version            Output version information and exit\n");
     printf("\n");
@@ -20,6 +20,7 @@
  *           https://github.com/admesh/admesh/issues
  */
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -34,8 +35,21 @@ static void stl_match_neighbors_nearby(stl_file *stl,
                                        stl_hash_edge *edge_a, stl_hash_edge *edge_b);
 static void stl_record_neighbors(stl_file *stl,
                                  stl_hash_edge *edge_a, stl_hash_edge *edge_b);
+static void stl_link_neighbors(stl_file *stl,
+                               stl_hash_edge *edge_a, stl_hash_edge *edge_b);
+static void stl_check_facets_exact_parallel(stl_file *stl);
+static int stl_facet_is_degenerate(stl_facet *facet);
+static float stl_load_edge_key(stl_hash_edge *edge,
+                               stl_vertex *a, stl_vertex *b);
 static void stl_initialize_facet_check_exact(stl_file *stl);
 static void stl_initialize_facet_check_nearby(stl_file *stl);
+static int *stl_get_unmatched_edges(stl_file *stl, int *count);
+static void stl_check_edges_nearby(stl_file *stl, float tolerance,
+                                   int *edges, int *count);
+static void stl_initialize_hash_edges(stl_file *stl, int number_of_edges,
+                                      const char *caller);
+static stl_hash_edge *stl_alloc_hash_edge(stl_file *stl);
+static void stl_release_hash_edge(stl_file *stl, stl_hash_edge *edge);
 static void stl_load_edge_exact(stl_file *stl, stl_hash_edge *edge,
                                 stl_vertex *a, stl_vertex *b);
 static int stl_load_edge_nearby(stl_file *stl, stl_hash_edge *edge,
@@ -43,7 +57,8 @@ static int stl_load_edge_nearby(stl_file *stl, stl_hash_edge *edge,
 static void insert_hash_edge(stl_file *stl, stl_hash_edge edge,
                              void (*match_neighbors)(stl_file *stl,
                                  stl_hash_edge *edge_a, stl_hash_edge *edge_b));
-static int stl_get_hash_for_edge(int M, stl_hash_edge *edge);
+static unsigned stl_get_hash_for_key(stl_hash_edge *edge);
+static unsigned stl_get_hash_for_edge(int M, stl_hash_edge *edge);
 static int stl_compare_function(stl_hash_edge *edge_a, stl_hash_edge *edge_b);
 static void stl_free_edges(stl_file *stl);
 static void stl_remove_facet(stl_file *stl, int facet_number);
@@ -78,18 +93,18 @@ stl_check_facets_exact(stl_file *stl) {
   stl->stats.connected_facets_2_edge = 0;
   stl->stats.connected_facets_3_edge = 0;
 
+  if(stl->threads > 1) {
+    stl_check_facets_exact_parallel(stl);
+    return;
+  }
+
   stl_initialize_facet_check_exact(stl);
 
   for(i = 0; i < stl->stats.number_of_facets; i++) {
     facet = stl->facet_start[i];
 
     /* If any two of the three vertices are found to be exactally the same, call them degenerate and remove the facet. */
-    if(   !memcmp(&facet.vertex[0], &facet.vertex[1],
-                  sizeof(stl_vertex))
-          || !memcmp(&facet.vertex[1], &facet.vertex[2],
-                     sizeof(stl_vertex))
-          || !memcmp(&facet.vertex[0], &facet.vertex[2],
-                     sizeof(stl_vertex))) {
+    if(stl_facet_is_degenerate(&facet)) {
       stl->stats.degenerate_facets += 1;
       stl_remove_facet(stl, i);
       i--;
@@ -108,23 +123,185 @@ stl_check_facets_exact(stl_file *stl) {
   stl_free_edges(stl);
 }
 
+/* The exact check on more threads.  The edges are split by their hash, so
+ * the edges that can match are always in the same part, and every thread
+ * runs the sequential algorithm on its own part with its own table.  The
+ * edges of a part are inserted in the same order as in the sequential
+ * check, so every edge finds the same neighbor, and the statistics are
+ * counted from the finished neighbors list. */
+
+typedef struct {
+  unsigned *hashes;          /* the hash of every edge, 3 per facet */
+  float    *shortest_edges;  /* the shortest edge of every thread */
+  stl_file *locals;          /* the hash table of every thread */
+} stl_exact_data;
+
+static void
+stl_hash_edges_exact(stl_file *stl, void *data, int thread, int threads) {
+  stl_exact_data *exact = (stl_exact_data*)data;
+  stl_hash_edge   edge;
+  stl_facet      *facet;
+  float           shortest_edge = stl->stats.shortest_edge;
+  float           max_diff;
+  int             begin;
+  int             end;
+  int             i;
+  int             j;
+
+  stl_parallel_range(stl->stats.number_of_facets, thread, threads,
+                     &begin, &end);
+  for(i = begin; i < end; i++) {
+    facet = &stl->facet_start[i];
+    for(j = 0; j < 3; j++) {
+      edge.facet_number = i;
+      edge.which_edge = j;
+      max_diff = stl_load_edge_key(&edge, &facet->vertex[j],
+                                   &facet->vertex[(j + 1) % 3]);
+      shortest_edge = STL_MIN(max_diff, shortest_edge);
+      exact->hashes[i * 3 + j] = stl_get_hash_for_key(&edge);
+    }
+  }
+  exact->shortest_edges[thread] = shortest_edge;
+}
+
+static void
+stl_match_edges_exact(stl_file *stl, void *data, int thread, int threads) {
+  stl_exact_data *exact = (stl_exact_data*)data;
+  stl_file       *local = &exact->locals[thread];
+  stl_hash_edge   edge;
+  stl_facet      *facet;
+  int             i;
+  int             j;
+
+  *local = *stl;
+  local->stats.memory_peak = local->stats.memory_allocated;
+  stl_initialize_hash_edges(local, stl->stats.number_of_facets * 3 / threads,
+                            "stl_check_facets_exact");
+  for(i = 0; i < stl->stats.number_of_facets; i++) {
+    for(j = 0; j < 3; j++) {
+      if((int)(((uint64_t)exact->hashes[i * 3 + j] * threads) >> 32) != thread) {
+        continue;
+      }
+      facet = &stl->facet_start[i];
+      edge.facet_number = i;
+      edge.which_edge = j;
+      stl_load_edge_key(&edge, &facet->vertex[j], &facet->vertex[(j + 1) % 3]);
+      insert_hash_edge(local, edge, stl_link_neighbors);
+    }
+  }
+  stl_free_edges(local);
+}
+
+static void
+stl_check_facets_exact_parallel(stl_file *stl) {
+  stl_exact_data exact;
+  long long      peak;
+  int            i;
+  int            j;
+
+  for(i = 0; i < stl->stats.number_of_facets ; i++) {
+    stl->neighbors_start[i].neighbor[0] = -1;
+    stl->neighbors_start[i].neighbor[1] = -1;
+    stl->neighbors_start[i].neighbor[2] = -1;
+  }
+
+  /* The degenerate facets are removed first, in the same way as the
+     sequential check removes them. */
+  for(i = 0; i < stl->stats.number_of_facets; i++) {
+    if(stl_facet_is_degenerate(&stl->facet_start[i])) {
+      stl->stats.degenerate_facets += 1;
+      stl_remove_facet(stl, i);
+      i--;
+    }
+  }
+
+  exact.hashes = (unsigned*)malloc(stl->stats.number_of_facets * 3 *
+                                   sizeof(unsigned));
+  exact.shortest_edges = (float*)malloc(stl->threads * sizeof(float));
+  exact.locals = (stl_file*)malloc(stl->threads * sizeof(stl_file));
+  if(exact.hashes == NULL || exact.shortest_edges == NULL ||
+     exact.locals == NULL) {
+    perror("stl_check_facets_exact");
+    free(exact.hashes);
+    free(exact.shortest_edges);
+    free(exact.locals);
+    stl->error = 1;
+    return;
+  }
+  stl_count_memory(stl, (long long)stl->stats.number_of_facets * 3 *
+                   sizeof(unsigned));
+
+  stl_parallel_run(stl, stl_hash_edges_exact, &exact);
+  for(i = 0; i < stl->threads; i++) {
+    stl->stats.shortest_edge = STL_MIN(exact.shortest_edges[i],
+                                       stl->stats.shortest_edge);
+  }
+
+  stl_parallel_run(stl, stl_match_edges_exact, &exact);
+  stl->stats.malloced = 0;
+  stl->stats.freed = 0;
+  stl->stats.collisions = 0;
+  /* The tables of the threads were there at the same time, every local
+     peak is counted from the memory the thread started with */
+  peak = stl->stats.memory_allocated;
+  for(i = 0; i < stl->threads; i++) {
+    stl->stats.malloced += exact.locals[i].stats.malloced;
+    stl->stats.freed += exact.locals[i].stats.freed;
+    stl->stats.collisions += exact.locals[i].stats.collisions;
+    peak += exact.locals[i].stats.memory_peak - stl->stats.memory_allocated;
+    if(exact.locals[i].error) stl->error = 1;
+  }
+  stl->stats.memory_peak = STL_MAX(stl->stats.memory_peak, peak);
+
+  for(i = 0; i < stl->stats.number_of_facets; i++) {
+    j = ((stl->neighbors_start[i].neighbor[0] != -1) +
+         (stl->neighbors_start[i].neighbor[1] != -1) +
+         (stl->neighbors_start[i].neighbor[2] != -1));
+    stl->stats.connected_edges += j;
+    if(j >= 1) stl->stats.connected_facets_1_edge += 1;
+    if(j >= 2) stl->stats.connected_facets_2_edge += 1;
+    if(j == 3) stl->stats.connected_facets_3_edge += 1;
+  }
+
+  free(exact.hashes);
+  free(exact.shortest_edges);
+  free(exact.locals);
+  stl_count_memory(stl, -(long long)stl->stats.number_of_facets * 3 *
+                   (long long)sizeof(unsigned));
+}
+
+static int
+stl_facet_is_degenerate(stl_facet *facet) {
+  return (   !memcmp(&facet->vertex[0], &facet->vertex[1], sizeof(stl_vertex))
+          || !memcmp(&facet->vertex[1], &facet->vertex[2], sizeof(stl_vertex))
+          || !memcmp(&facet->vertex[0], &facet->vertex[2], sizeof(stl_vertex)));
+}
+
 static void
 stl_load_edge_exact(stl_file *stl, stl_hash_edge *edge,
                     stl_vertex *a, stl_vertex *b) {
+  float max_diff;
+
+  if (stl->error) return;
+
+  max_diff = stl_load_edge_key(edge, a, b);
+  stl->stats.shortest_edge = STL_MIN(max_diff, stl->stats.shortest_edge);
+}
 
+static float
+stl_load_edge_key(stl_hash_edge *edge, stl_vertex *a, stl_vertex *b) {
+  /* Loads the key of the edge, the longer direction first, and returns
+     the length of the edge along that direction. */
   float diff_x;
   float diff_y;
   float diff_z;
   float max_diff;
 
-  if (stl->error) return;
-
   diff_x = ABS(a->x - b->x);
   diff_y = ABS(a->y - b->y);
   diff_z = ABS(a->z - b->z);
   max_diff = STL_MAX(diff_x, diff_y);
   max_diff = STL_MAX(diff_z, max_diff);
-  stl->stats.shortest_edge = STL_MIN(max_diff, stl->stats.shortest_edge);
 
   if(diff_x == max_diff) {
     if(a->x > b->x) {
@@ -154,6 +331,7 @@ stl_load_edge_exact(stl_file *stl, stl_hash_edge *edge,
       edge->which_edge += 3; /* this edge is loaded backwards */
     }
   }
+  return max_diff;
 }
 
 static void
@@ -162,13 +340,6 @@ stl_initialize_facet_check_exact(stl_file *stl) {
 
   if (stl->error) return;
 
-  stl->stats.malloced = 0;
-  stl->stats.freed = 0;
-  stl->stats.collisions = 0;
-
-
-  stl->M = 81397;
-
   for(i = 0; i < stl->stats.number_of_facets ; i++) {
     /* initialize neighbors list to -1 to mark unconnected edges */
     stl->neighbors_start[i].neighbor[0] = -1;
@@ -176,17 +347,83 @@ stl_initialize_facet_check_exact(stl_file *stl) {
     stl->neighbors_start[i].neighbor[2] = -1;
   }
 
-  stl->heads = (stl_hash_edge**)calloc(stl->M, sizeof(*stl->heads));
-  if(stl->heads == NULL) perror("stl_initialize_facet_check_exact");
+  stl_initialize_hash_edges(stl, stl->stats.number_of_facets * 3,
+                            "stl_initialize_facet_check_exact");
+}
+
+static void
+stl_initialize_hash_edges(stl_file *stl, int number_of_edges,
+                          const char *caller) {
+  /* The table is sized from the number of edges that can be inserted, so
+   * the chains stay short on big files.  The number of buckets is a power
+   * of two, so the hash can be masked instead of divided.  The edges
+   * themselves come from blocks allocated up front instead of one malloc
+   * per edge. */
+  int i;
+
+  stl->stats.malloced = 0;
+  stl->stats.freed = 0;
+  stl->stats.collisions = 0;
+
+  stl->M = 1024;
+  while(stl->M < number_of_edges / 2 && stl->M < (1 << 30)) {
+    stl->M <<= 1;
+  }
+
+  stl->heads = (stl_hash_edge**)malloc(stl->M * sizeof(*stl->heads));
+  if(stl->heads == NULL) perror(caller);
 
   stl->tail = (stl_hash_edge*)malloc(sizeof(stl_hash_edge));
-  if(stl->tail == NULL) perror("stl_initialize_facet_check_exact");
+  if(stl->tail == NULL) perror(caller);
 
   stl->tail->next = stl->tail;
+  stl_count_memory(stl, (long long)stl->M * sizeof(*stl->heads) +
+                   sizeof(stl_hash_edge));
 
   for(i = 0; i < stl->M; i++) {
     stl->heads[i] = stl->tail;
   }
+
+  stl->edge_blocks = NULL;
+  stl->edge_free = NULL;
+  stl->edge_block_size = STL_MAX(1024, number_of_edges / 4);
+}
+
+static stl_hash_edge *
+stl_alloc_hash_edge(stl_file *stl) {
+  /* Every block starts with a header element that links the blocks, the
+   * rest of the elements go to the free list. */
+  stl_hash_edge *block;
+  stl_hash_edge *edge;
+  int i;
+
+  if(stl->edge_free == NULL) {
+    block = (stl_hash_edge*)malloc(stl->edge_block_size * sizeof(stl_hash_edge));
+    if(block == NULL) {
+      perror("stl_alloc_hash_edge");
+      return NULL;
+    }
+    stl_count_memory(stl, (long long)stl->edge_block_size *
+                     sizeof(stl_hash_edge));
+    block->next = stl->edge_blocks;
+    stl->edge_blocks = block;
+    for(i = stl->edge_block_size - 1; i > 0; i--) {
+      block[i].next = stl->edge_free;
+      stl->edge_free = &block[i];
+    }
+  }
+
+  edge = stl->edge_free;
+  stl->edge_free = edge->next;
+  stl->stats.malloced++;
+  return edge;
+}
+
+static void
+stl_release_hash_edge(stl_file *stl, stl_hash_edge *edge) {
+  edge->next = stl->edge_free;
+  stl->edge_free = edge;
+  stl->stats.freed++;
 }
 
 static void
@@ -196,7 +433,7 @@ insert_hash_edge(stl_file *stl, stl_hash_edge edge,
   stl_hash_edge *link;
   stl_hash_edge *new_edge;
   stl_hash_edge *temp;
-  int            chain_number;
+  unsigned       chain_number;
 
   if (stl->error) return;
 
@@ -206,9 +443,11 @@ insert_hash_edge(stl_file *stl, stl_hash_edge edge,
 
   if(link == stl->tail) {
     /* This list doesn't have any edges currently in it.  Add this one. */
-    new_edge = (stl_hash_edge*)malloc(sizeof(stl_hash_edge));
-    if(new_edge == NULL) perror("insert_hash_edge");
-    stl->stats.malloced++;
+    new_edge = stl_alloc_hash_edge(stl);
+    if(new_edge == NULL) {
+      stl->error = 1;
+      return;
+    }
     *new_edge = edge;
     new_edge->next = stl->tail;
     stl->heads[chain_number] = new_edge;
@@ -218,17 +457,18 @@ insert_hash_edge(stl_file *stl, stl_hash_edge edge,
     match_neighbors(stl, &edge, link);
     /* Delete the matched edge from the list. */
     stl->heads[chain_number] = link->next;
-    free(link);
-    stl->stats.freed++;
+    stl_release_hash_edge(stl, link);
     return;
   } else {
     /* Continue through the rest of the list */
     for(;;) {
       if(link->next == stl->tail) {
         /* This is the last item in the list. Insert a new edge. */
-        new_edge = (stl_hash_edge*)malloc(sizeof(stl_hash_edge));
-        if(new_edge == NULL) perror("insert_hash_edge");
-        stl->stats.malloced++;
+        new_edge = stl_alloc_hash_edge(stl);
+        if(new_edge == NULL) {
+          stl->error = 1;
+          return;
+        }
         *new_edge = edge;
         new_edge->next = stl->tail;
         link->next = new_edge;
@@ -241,8 +481,7 @@ insert_hash_edge(stl_file *stl, stl_hash_edge edge,
         /* Delete the matched edge from the list. */
         temp = link->next;
         link->next = link->next->next;
-        free(temp);
-        stl->stats.freed++;
+        stl_release_hash_edge(stl, temp);
         return;
       } else {
         /* This is not a match.  Go to the next link */
@@ -254,10 +493,23 @@ insert_hash_edge(stl_file *stl, stl_hash_edge edge,
 }
 
 
-static int
+static unsigned
+stl_get_hash_for_key(stl_hash_edge *edge) {
+  /* multiply-xorshift over all six words of the key */
+  uint64_t hash = 0;
+  int i;
+
+  for(i = 0; i < 6; i++) {
+    hash = (hash ^ edge->key[i]) * UINT64_C(0x9e3779b97f4a7c15);
+    hash ^= hash >> 29;
+  }
+  return (unsigned)(hash >> 32);
+}
+
+static unsigned
 stl_get_hash_for_edge(int M, stl_hash_edge *edge) {
-  return ((edge->key[0] / 23 + edge->key[1] / 19 + edge->key[2] / 17
-           + edge->key[3] /13  + edge->key[4] / 11 + edge->key[5] / 7 ) % M);
+  /* M is a power of two */
+  return stl_get_hash_for_key(edge) & (unsigned)(M - 1);
 }
 
 static int
@@ -271,10 +523,8 @@ stl_compare_function(stl_hash_edge *edge_a, stl_hash_edge *edge_b) {
 
 void
 stl_check_facets_nearby(stl_file *stl, float tolerance) {
-  stl_hash_edge  edge[3];
-  stl_facet      facet;
-  int            i;
-  int            j;
+  int *edges;
+  int count;
 
   if (stl->error) return;
 
@@ -285,25 +535,159 @@ stl_check_facets_nearby(stl_file *stl, float tolerance) {
     return;
   }
 
-  stl_initialize_facet_check_nearby(stl);
+  edges = stl_get_unmatched_edges(stl, &count);
+  stl_check_edges_nearby(stl, tolerance, edges, &count);
+  free(edges);
+}
+
+void
+stl_check_facets_nearby_iterations(stl_file *stl, float tolerance,
+                                   float increment, int iterations,
+                                   int verbose_flag) {
+  /* Runs the nearby check with a growing tolerance.  Nothing but the
+   * nearby check changes the neighbors between the iterations, so only
+   * the edges that are still unmatched are checked again instead of all
+   * the facets. */
+  int *edges = NULL;
+  int count = 0;
+  int last_edges_fixed = stl->stats.edges_fixed;
+  int i;
+
+  if (stl->error) return;
+
+  for(i = 0; i < iterations; i++) {
+    if(stl->stats.connected_facets_3_edge <
+        stl->stats.number_of_facets) {
+      if (verbose_flag)
+        printf("\
+Checking nearby. Tolerance= %f Iteration=%d of %d...",
+             tolerance, i + 1, iterations);
+      if(edges == NULL) {
+        edges = stl_get_unmatched_edges(stl, &count);
+      }
+      stl_check_edges_nearby(stl, tolerance, edges, &count);
+      if (verbose_flag)
+        printf("  Fixed %d edges.\n",
+             stl->stats.edges_fixed - last_edges_fixed);
+      last_edges_fixed = stl->stats.edges_fixed;
+      tolerance += increment;
+    } else {
+      if (verbose_flag)
+        printf("\
+All facets connected.  No further nearby check necessary.\n");
+      break;
+    }
+  }
+  free(edges);
+}
+
+static int *
+stl_get_unmatched_edges(stl_file *stl, int *count) {
+  /* Lists the edges without a neighbor as facet * 3 + edge, in the same
+   * order as the facets. */
+  int *edges;
+  int i;
+  int j;
+
+  *count = 0;
+  if (stl->error) return NULL;
 
   for(i = 0; i < stl->stats.number_of_facets; i++) {
-    facet = stl->facet_start[i];
+    for(j = 0; j < 3; j++) {
+      if(stl->neighbors_start[i].neighbor[j] == -1) (*count)++;
+    }
+  }
+
+  edges = (int*)malloc(STL_MAX(1, *count) * sizeof(int));
+  if(edges == NULL) {
+    perror("stl_get_unmatched_edges");
+    stl->error = 1;
+    *count = 0;
+    return NULL;
+  }
+
+  *count = 0;
+  for(i = 0; i < stl->stats.number_of_facets; i++) {
     for(j = 0; j < 3; j++) {
       if(stl->neighbors_start[i].neighbor[j] == -1) {
-        edge[j].facet_number = i;
-        edge[j].which_edge = j;
-        if(stl_load_edge_nearby(stl, &edge[j], &facet.vertex[j],
-                                &facet.vertex[(j + 1) % 3],
-                                tolerance)) {
-          /* only insert edges that have different keys */
-          insert_hash_edge(stl, edge[j], stl_match_neighbors_nearby);
-        }
+        edges[(*count)++] = i * 3 + j;
+      }
+    }
+  }
+  return edges;
+}
+
+static void
+stl_check_edges_nearby(stl_file *stl, float tolerance,
+                       int *edges, int *count) {
+  /* The cells of the tolerance grid are the keys of the hash, so only the
+   * edges whose both ends fall into the same cells are compared.  The
+   * edges that are still unmatched stay in the list for the next call. */
+  stl_hash_edge  edge;
+  stl_facet      facet;
+  int            facet_number;
+  int            last_facet = -1;
+  int            i;
+  int            j;
+  int            k;
+
+  if (stl->error) return;
+
+  stl_initialize_hash_edges(stl, *count, "stl_check_facets_nearby");
+
+  for(k = 0; k < *count; k++) {
+    facet_number = edges[k] / 3;
+    j = edges[k] % 3;
+    if(facet_number != last_facet) {
+      /* the vertices are read once for all the edges of the facet */
+      facet = stl->facet_start[facet_number];
+      last_facet = facet_number;
+    }
+    if(stl->neighbors_start[facet_number].neighbor[j] == -1) {
+      edge.facet_number = facet_number;
+      edge.which_edge = j;
+      if(stl_load_edge_nearby(stl, &edge, &facet.vertex[j],
+                              &facet.vertex[(j + 1) % 3],
+                              tolerance)) {
+        /* only insert edges that have different keys */
+        insert_hash_edge(stl, edge, stl_match_neighbors_nearby);
       }
     }
   }
 
   stl_free_edges(stl);
+
+  i = 0;
+  for(k = 0; k < *count; k++) {
+    if(stl->neighbors_start[edges[k] / 3].neighbor[edges[k] % 3] == -1) {
+      edges[i++] = edges[k];
+    }
+  }
+  *count = i;
+}
+
+static void
+stl_initialize_facet_check_nearby(stl_file *stl) {
+  int number_of_edges;
+  int i;
+  int j;
+
+  if (stl->error) return;
+
+  /*  tolerance = STL_MAX(stl->stats.shortest_edge, tolerance);*/
+  /*  tolerance = STL_MAX((stl->stats.bounding_diameter / 500000.0), tolerance);*/
+  /*  tolerance *= 0.5;*/
+
+  /* only the unconnected edges go into the table */
+  number_of_edges = 0;
+  for(i = 0; i < stl->stats.number_of_facets; i++) {
+    for(j = 0; j < 3; j++) {
+      if(stl->neighbors_start[i].neighbor[j] == -1) number_of_edges++;
+    }
+  }
+
+  stl_initialize_hash_edges(stl, number_of_edges,
+                            "stl_initialize_facet_check_nearby");
 }
 
 static int
@@ -370,62 +754,66 @@ stl_load_edge_nearby(stl_file *stl, stl_hash_edge *edge,
 
 static void
 stl_free_edges(stl_file *stl) {
-  int i;
-  stl_hash_edge *temp;
+  stl_hash_edge *block;
 
   if (stl->error) return;
 
-  if(stl->stats.malloced != stl->stats.freed) {
-    for(i = 0; i < stl->M; i++) {
-      for(temp = stl->heads[i]; stl->heads[i] != stl->tail;
-          temp = stl->heads[i]) {
-        stl->heads[i] = stl->heads[i]->next;
-        free(temp);
-        stl->stats.freed++;
-      }
-    }
+  /* the edges still in the table go away with their blocks */
+  stl->stats.freed = stl->stats.malloced;
+  while(stl->edge_blocks != NULL) {
+    block = stl->edge_blocks;
+    stl->edge_blocks = block->next;
+    free(block);
+    stl_count_memory(stl, -(long long)stl->edge_block_size *
+                     (long long)sizeof(stl_hash_edge));
   }
+  stl->edge_free = NULL;
   free(stl->heads);
   free(stl->tail);
+  stl_count_memory(stl, -((long long)stl->M * (long long)sizeof(*stl->heads) +
+                          (long long)sizeof(stl_hash_edge)));
 }
 
 static void
-stl_initialize_facet_check_nearby(stl_file *stl) {
+stl_record_neighbors(stl_file *stl,
+                     stl_hash_edge *edge_a, stl_hash_edge *edge_b) {
   int i;
+  int j;
 
   if (stl->error) return;
 
-  stl->stats.malloced = 0;
-  stl->stats.freed = 0;
-  stl->stats.collisions = 0;
-
-  /*  tolerance = STL_MAX(stl->stats.shortest_edge, tolerance);*/
-  /*  tolerance = STL_MAX((stl->stats.bounding_diameter / 500000.0), tolerance);*/
-  /*  tolerance *= 0.5;*/
-
-  stl->M = 81397;
-
-  stl->heads = (stl_hash_edge**)calloc(stl->M, sizeof(*stl->heads));
-  if(stl->heads == NULL) perror("stl_initialize_facet_check_nearby");
+  stl_link_neighbors(stl, edge_a, edge_b);
 
-  stl->tail = (stl_hash_edge*)malloc(sizeof(stl_hash_edge));
-  if(stl->tail == NULL) perror("stl_initialize_facet_check_nearby");
-
-  stl->tail->next = stl->tail;
-
-  for(i = 0; i < stl->M; i++) {
-    stl->heads[i] = stl->tail;
+  /* Count successful connects */
+  /* Total connects */
+  stl->stats.connected_edges += 2;
+  /* Count individual connects */
+  i = ((stl->neighbors_start[edge_a->facet_number].neighbor[0] == -1) +
+       (stl->neighbors_start[edge_a->facet_number].neighbor[1] == -1) +
+       (stl->neighbors_start[edge_a->facet_number].neighbor[2] == -1));
+  j = ((stl->neighbors_start[edge_b->facet_number].neighbor[0] == -1) +
+       (stl->neighbors_start[edge_b->facet_number].neighbor[1] == -1) +
+       (stl->neighbors_start[edge_b->facet_number].neighbor[2] == -1));
+  if(i == 2) {
+    stl->stats.connected_facets_1_edge +=1;
+  } else if(i == 1) {
+    stl->stats.connected_facets_2_edge +=1;
+  } else {
+    stl->stats.connected_facets_3_edge +=1;
+  }
+  if(j == 2) {
+    stl->stats.connected_facets_1_edge +=1;
+  } else if(j == 1) {
+    stl->stats.connected_facets_2_edge +=1;
+  } else {
+    stl->stats.connected_facets_3_edge +=1;
   }
 }
 
-
-
 static void
-stl_record_neighbors(stl_file *stl,
-                     stl_hash_edge *edge_a, stl_hash_edge *edge_b) {
-  int i;
-  int j;
-
+stl_link_neighbors(stl_file *stl,
+                   stl_hash_edge *edge_a, stl_hash_edge *edge_b) {
+  /* Only writes the neighbors list, so the parallel exact check can use it */
   if (stl->error) return;
 
   /* Facet a's neighbor is facet b */
@@ -453,32 +841,6 @@ stl_record_neighbors(stl_file *stl,
     stl->neighbors_start[edge_b->facet_number].
     which_vertex_not[edge_b->which_edge % 3] += 3;
   }
-
-
-  /* Count successful connects */
-  /* Total connects */
-  stl->stats.connected_edges += 2;
-  /* Count individual connects */
-  i = ((stl->neighbors_start[edge_a->facet_number].neighbor[0] == -1) +
-       (stl->neighbors_start[edge_a->facet_number].neighbor[1] == -1) +
-       (stl->neighbors_start[edge_a->facet_number].neighbor[2] == -1));
-  j = ((stl->neighbors_start[edge_b->facet_number].neighbor[0] == -1) +
-       (stl->neighbors_start[edge_b->facet_number].neighbor[1] == -1) +
-       (stl->neighbors_start[edge_b->facet_number].neighbor[2] == -1));
-  if(i == 2) {
-    stl->stats.connected_facets_1_edge +=1;
-  } else if(i == 1) {
-    stl->stats.connected_facets_2_edge +=1;
-  } else {
-    stl->stats.connected_facets_3_edge +=1;
-  }
-  if(j == 2) {
-    stl->stats.connected_facets_1_edge +=1;
-  } else if(j == 1) {
-    stl->stats.connected_facets_2_edge +=1;
-  } else {
-    stl->stats.connected_facets_3_edge +=1;
-  }
 }
 
 static void
@@ -574,7 +936,7 @@ stl_change_vertices(stl_file *stl, int facet_num, int vnot,
 
     if(facet_num == first_facet) {
       /* back to the beginning */
-      printf("\
+      fprintf(stderr, "\
 Back to the first facet changing vertices: probably a mobius part.\n\
 Try using a smaller tolerance or don't do a nearby check\n");
       return;
@@ -693,7 +1055,7 @@ stl_remove_facet(stl_file *stl, int facet_number) {
     if(neighbor[i] != -1) {
       if(stl->neighbors_start[neighbor[i]].neighbor[(vnot[i] + 1)% 3] !=
           stl->stats.number_of_facets) {
-        printf("\
+        fprintf(stderr, "\
 in stl_remove_facet: neighbor = %d numfacets = %d this is wrong\n",
                stl->neighbors_start[neighbor[i]].neighbor[(vnot[i] + 1)% 3],
                stl->stats.number_of_facets);
@@ -764,7 +1126,7 @@ stl_remove_degenerate(stl_file *stl, int facet) {
                    &stl->facet_start[facet].vertex[2], sizeof(stl_vertex))) {
     /* all 3 vertices are equal.  Just remove the facet.  I don't think*/
     /* this is really possible, but just in case... */
-    printf("removing a facet in stl_remove_degenerate\n");
+    fprintf(stderr, "removing a facet in stl_remove_degenerate\n");
 
     stl_remove_facet(stl, facet);
     return;
@@ -937,14 +1299,16 @@ stl_fill_holes(stl_file *stl) {
 
         if(facet_num == first_facet) {
           /* back to the beginning */
-          printf("\
+          fprintf(stderr, "\
 Back to the first facet filling holes: probably a mobius part.\n\
 Try using a smaller tolerance or don't do a nearby check\n");
+          stl_free_edges(stl);
           return;
         }
       }
     }
   }
+  stl_free_edges(stl);
 }
 
 void
@@ -960,6 +1324,7 @@ stl_add_facet(stl_file *stl, stl_facet *new_facet) {
                            (sizeof(stl_neighbors) * (stl->stats.facets_malloced + 256)));
     if(stl->neighbors_start == NULL) perror("stl_add_facet");
     stl->stats.facets_malloced += 256;
+    stl_count_memory(stl, 256 * (sizeof(stl_facet) + sizeof(stl_neighbors)));
   }
   stl->facet_start[stl->stats.number_of_facets] = *new_facet;
 
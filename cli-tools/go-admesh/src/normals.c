@@ -28,17 +28,31 @@
 #include "stl.h"
 
 static void stl_reverse_facet(stl_file *stl, int facet_num);
+static void stl_reverse_facet_counted(stl_file *stl, int facet_num,
+                                      int *facets_reversed);
+static int stl_fix_part_directions(stl_file *stl, int facet_num,
+                                   unsigned char *fixed, int **stack,
+                                   int *stack_size, int *facets_reversed);
+static void stl_fix_normal_directions_parallel(stl_file *stl);
 static void stl_reverse_vector(float v[]);
 int stl_check_normal_vector(stl_file *stl, int facet_num, int normal_fix_flag);
+static int stl_check_facet_normal(stl_facet *facet, int normal_fix_flag,
+                                  int *normals_fixed);
 
 static void
 stl_reverse_facet(stl_file *stl, int facet_num) {
+  stl_reverse_facet_counted(stl, facet_num, &stl->stats.facets_reversed);
+}
+
+static void
+stl_reverse_facet_counted(stl_file *stl, int facet_num,
+                          int *facets_reversed) {
   stl_vertex tmp_vertex;
   /*  int tmp_neighbor;*/
   int neighbor[3];
   int vnot[3];
 
-  stl->stats.facets_reversed += 1;
+  *facets_reversed += 1;
 
   neighbor[0] = stl->neighbors_start[facet_num].neighbor[0];
   neighbor[1] = stl->neighbors_start[facet_num].neighbor[1];
@@ -84,117 +98,285 @@ stl_reverse_facet(stl_file *stl, int facet_num) {
     (stl->neighbors_start[facet_num].which_vertex_not[2] + 3) % 6;
 }
 
-void
-stl_fix_normal_directions(stl_file *stl) {
-  char *norm_sw;
-  /*  int edge_num;*/
-  /*  int vnot;*/
+/* The facets that are already fixed are kept in a bitset */
+#define STL_FIXED(fixed, i) ((fixed)[(i) >> 3] & (1 << ((i) & 7)))
+#define STL_SET_FIXED(fixed, i) ((fixed)[(i) >> 3] |= (1 << ((i) & 7)))
+
+static int
+stl_fix_part_directions(stl_file *stl, int facet_num, unsigned char *fixed,
+                        int **stack, int *stack_size, int *facets_reversed) {
+  /* Fixes the part of facet_num, and returns the number of facets that were
+     fixed.  The facets to visit are kept on a stack that grows if needed,
+     a facet can be on it more than once. */
   int checked = 0;
-  int facet_num;
-  /*  int next_facet;*/
-  int i;
+  int top = 0;
+  int neighbor;
+  int *new_stack;
   int j;
-  struct stl_normal {
-    int               facet_num;
-    struct stl_normal *next;
-  };
-  struct stl_normal *head;
-  struct stl_normal *tail;
-  struct stl_normal *newn;
-  struct stl_normal *temp;
-
-  if (stl->error) return;
-
-  /* Initialize linked list. */
-  head = (struct stl_normal*)malloc(sizeof(struct stl_normal));
-  if(head == NULL) perror("stl_fix_normal_directions");
-  tail = (struct stl_normal*)malloc(sizeof(struct stl_normal));
-  if(tail == NULL) perror("stl_fix_normal_directions");
-  head->next = tail;
-  tail->next = tail;
 
-  /* Initialize list that keeps track of already fixed facets. */
-  norm_sw = (char*)calloc(stl->stats.number_of_facets, sizeof(char));
-  if(norm_sw == NULL) perror("stl_fix_normal_directions");
-
-
-  facet_num = 0;
   /* If normal vector is not within tolerance and backwards:
-     Arbitrarily starts at face 0.  If this one is wrong, we're screwed.  Thankfully, the chances
-     of it being wrong randomly are low if most of the triangles are right: */
-  if(stl_check_normal_vector(stl, 0, 0) == 2)
-    stl_reverse_facet(stl, 0);
+     Arbitrarily starts at the first facet of the part.  If this one is wrong, we're screwed.
+     Thankfully, the chances of it being wrong randomly are low if most of the triangles are right: */
+  if(stl_check_normal_vector(stl, facet_num, 0) == 2)
+    stl_reverse_facet_counted(stl, facet_num, facets_reversed);
 
   /* Say that we've fixed this facet: */
-  norm_sw[facet_num] = 1;
+  STL_SET_FIXED(fixed, facet_num);
   checked++;
 
   for(;;) {
     /* Add neighbors_to_list.
        Add unconnected neighbors to the list:a  */
     for(j = 0; j < 3; j++) {
+      neighbor = stl->neighbors_start[facet_num].neighbor[j];
+      /* If the facet has a neighbor that is -1, it means that edge isn't shared by another facet */
+      if(neighbor == -1) continue;
       /* Reverse the neighboring facets if necessary. */
       if(stl->neighbors_start[facet_num].which_vertex_not[j] > 2) {
-        /* If the facet has a neighbor that is -1, it means that edge isn't shared by another facet */
-        if(stl->neighbors_start[facet_num].neighbor[j] != -1) {
-          stl_reverse_facet
-          (stl, stl->neighbors_start[facet_num].neighbor[j]);
-        }
+        stl_reverse_facet_counted(stl, neighbor, facets_reversed);
       }
-      /* If this edge of the facet is connected: */
-      if(stl->neighbors_start[facet_num].neighbor[j] != -1) {
-        /* If we haven't fixed this facet yet, add it to the list: */
-        if(norm_sw[stl->neighbors_start[facet_num].neighbor[j]] != 1) {
-          /* Add node to beginning of list. */
-          newn = (struct stl_normal*)malloc(sizeof(struct stl_normal));
-          if(newn == NULL) perror("stl_fix_normal_directions");
-          newn->facet_num = stl->neighbors_start[facet_num].neighbor[j];
-          newn->next = head->next;
-          head->next = newn;
+      /* If we haven't fixed this facet yet, add it to the list: */
+      if(!STL_FIXED(fixed, neighbor)) {
+        if(top == *stack_size) {
+          new_stack = (int*)realloc(*stack, 2 * *stack_size * sizeof(int));
+          if(new_stack == NULL) {
+            perror("stl_fix_normal_directions");
+            return -1;
+          }
+          *stack = new_stack;
+          *stack_size *= 2;
         }
+        (*stack)[top++] = neighbor;
       }
     }
     /* Get next facet to fix from top of list. */
-    if(head->next != tail) {
-      facet_num = head->next->facet_num;
-      if(norm_sw[facet_num] != 1) { /* If facet is in list mutiple times */
-        norm_sw[facet_num] = 1; /* Record this one as being fixed. */
-        checked++;
-      }
-      temp = head->next;	/* Delete this facet from the list. */
-      head->next = head->next->next;
-      free(temp);
-    } else { /* if we ran out of facets to fix: */
+    if(top == 0) {
       /* All of the facets in this part have been fixed. */
-      stl->stats.number_of_parts += 1;
-      if(checked >= stl->stats.number_of_facets) {
-        /* All of the facets have been checked.  Bail out. */
+      return checked;
+    }
+    facet_num = (*stack)[--top];
+    if(!STL_FIXED(fixed, facet_num)) { /* If facet is in list mutiple times */
+      STL_SET_FIXED(fixed, facet_num); /* Record this one as being fixed. */
+      checked++;
+    }
+  }
+}
+
+void
+stl_fix_normal_directions(stl_file *stl) {
+  unsigned char *fixed;
+  int *stack;
+  int stack_size;
+  int checked = 0;
+  int facet_num = 0;
+  int part_checked;
+
+  if (stl->error) return;
+
+  if(stl->threads > 1) {
+    stl_fix_normal_directions_parallel(stl);
+    return;
+  }
+
+  /* Initialize list that keeps track of already fixed facets. */
+  fixed = (unsigned char*)calloc(stl->stats.number_of_facets / 8 + 1, 1);
+  stack_size = STL_MAX(1, stl->stats.number_of_facets);
+  stack = (int*)malloc(stack_size * sizeof(int));
+  if(fixed == NULL || stack == NULL) {
+    perror("stl_fix_normal_directions");
+    free(fixed);
+    free(stack);
+    stl->error = 1;
+    return;
+  }
+  stl_count_memory(stl, stl->stats.number_of_facets / 8 + 1 +
+                   (long long)stack_size * sizeof(int));
+
+  for(;;) {
+    part_checked = stl_fix_part_directions(stl, facet_num, fixed, &stack,
+                                           &stack_size,
+                                           &stl->stats.facets_reversed);
+    if(part_checked < 0) {
+      stl->error = 1;
+      break;
+    }
+    checked += part_checked;
+    stl->stats.number_of_parts += 1;
+    if(checked >= stl->stats.number_of_facets) {
+      /* All of the facets have been checked.  Bail out. */
+      break;
+    }
+    /* There is another part here.  Its first facet is the first one that
+       isn't fixed, and every facet before facet_num is fixed already. */
+    while(STL_FIXED(fixed, facet_num)) {
+      facet_num++;
+    }
+  }
+  free(fixed);
+  free(stack);
+  /* as counted above, before the stack could grow */
+  stl_count_memory(stl, -(stl->stats.number_of_facets / 8 + 1 +
+                          (long long)STL_MAX(1, stl->stats.number_of_facets) *
+                          (long long)sizeof(int)));
+}
+
+/* With more threads the parts are labelled first, and the parts are fixed
+   on the threads.  Every part starts at its first facet, as above, and the
+   reversals only change the facets of the part, so the result is the same. */
+
+typedef struct {
+  int  *first_facets;     /* the first facet of every part */
+  int  number_of_parts;
+  int  *facets_reversed;  /* the facets reversed on every thread */
+  char *errors;           /* set if a thread ran out of memory */
+} stl_directions_data;
+
+static void
+stl_fix_parts_directions(stl_file *stl, void *data, int thread, int threads) {
+  stl_directions_data *directions = (stl_directions_data*)data;
+  unsigned char *fixed;
+  int *stack;
+  int stack_size;
+  int i;
+
+  fixed = (unsigned char*)calloc(stl->stats.number_of_facets / 8 + 1, 1);
+  stack_size = 1024;
+  stack = (int*)malloc(stack_size * sizeof(int));
+  if(fixed == NULL || stack == NULL) {
+    perror("stl_fix_normal_directions");
+    directions->errors[thread] = 1;
+  } else {
+    for(i = thread; i < directions->number_of_parts; i += threads) {
+      if(stl_fix_part_directions(stl, directions->first_facets[i], fixed,
+                                 &stack, &stack_size,
+                                 &directions->facets_reversed[thread]) < 0) {
+        directions->errors[thread] = 1;
         break;
-      } else {
-        /* There is another part here.  Find it and continue. */
-        for(i = 0; i < stl->stats.number_of_facets; i++) {
-          if(norm_sw[i] == 0) {
-            /* This is the first facet of the next part. */
-            facet_num = i;
-            if(stl_check_normal_vector(stl, i, 0) == 2) {
-              stl_reverse_facet(stl, i);
-            }
-
-            norm_sw[facet_num] = 1;
-            checked++;
-            break;
-          }
+      }
+    }
+  }
+  free(fixed);
+  free(stack);
+}
+
+int
+stl_label_parts(stl_file *stl, int *parts, int *first_facets) {
+  /* Sets parts[i] to the part of facet i, the facets connected through
+     the neighbors are one part.  The parts are numbered in the order of
+     their lowest facet, which goes to first_facets if that isn't NULL.
+     Returns the number of parts, or -1 if there is no memory. */
+  int *queue;
+  int number_of_parts;
+  int head;
+  int tail;
+  int facet_num;
+  int neighbor;
+  int i;
+  int j;
+
+  if (stl->error) return -1;
+
+  queue = (int*)malloc(STL_MAX(1, stl->stats.number_of_facets) * sizeof(int));
+  if(queue == NULL) {
+    perror("stl_label_parts");
+    stl->error = 1;
+    return -1;
+  }
+  stl_count_memory(stl, (long long)STL_MAX(1, stl->stats.number_of_facets) *
+                   sizeof(int));
+
+  for(i = 0; i < stl->stats.number_of_facets; i++) {
+    parts[i] = -1;
+  }
+  number_of_parts = 0;
+  for(i = 0; i < stl->stats.number_of_facets; i++) {
+    if(parts[i] != -1) continue;
+    if(first_facets != NULL) first_facets[number_of_parts] = i;
+    parts[i] = number_of_parts;
+    head = 0;
+    tail = 0;
+    queue[tail++] = i;
+    while(head < tail) {
+      facet_num = queue[head++];
+      for(j = 0; j < 3; j++) {
+        neighbor = stl->neighbors_start[facet_num].neighbor[j];
+        if(neighbor != -1 && parts[neighbor] == -1) {
+          parts[neighbor] = number_of_parts;
+          queue[tail++] = neighbor;
         }
       }
     }
+    number_of_parts++;
   }
-  free(head);
-  free(tail);
-  free(norm_sw);
+  free(queue);
+  stl_count_memory(stl, -(long long)STL_MAX(1, stl->stats.number_of_facets) *
+                   (long long)sizeof(int));
+  return number_of_parts;
+}
+
+static void
+stl_fix_normal_directions_parallel(stl_file *stl) {
+  stl_directions_data directions;
+  long long threads_memory;
+  int *parts;
+  int i;
+
+  parts = (int*)malloc(STL_MAX(1, stl->stats.number_of_facets) * sizeof(int));
+  directions.first_facets =
+    (int*)malloc(STL_MAX(1, stl->stats.number_of_facets) * sizeof(int));
+  directions.facets_reversed = (int*)calloc(stl->threads, sizeof(int));
+  directions.errors = (char*)calloc(stl->threads, sizeof(char));
+  if(parts == NULL || directions.first_facets == NULL ||
+     directions.facets_reversed == NULL || directions.errors == NULL) {
+    perror("stl_fix_normal_directions");
+    free(parts);
+    free(directions.first_facets);
+    free(directions.facets_reversed);
+    free(directions.errors);
+    stl->error = 1;
+    return;
+  }
+  stl_count_memory(stl, 2 * (long long)STL_MAX(1, stl->stats.number_of_facets) *
+                   sizeof(int));
+
+  /* Label the parts, the first facet of a part is its lowest one */
+  directions.number_of_parts = stl_label_parts(stl, parts,
+                                               directions.first_facets);
+  free(parts);
+  stl_count_memory(stl, -(long long)STL_MAX(1, stl->stats.number_of_facets) *
+                   (long long)sizeof(int));
+
+  if(directions.number_of_parts >= 0) {
+    /* The lists of the threads are counted here, the threads don't touch
+       the statistics */
+    threads_memory = (long long)stl->threads *
+                     (stl->stats.number_of_facets / 8 + 1 + 1024 * sizeof(int));
+    stl_count_memory(stl, threads_memory);
+    stl_parallel_run(stl, stl_fix_parts_directions, &directions);
+    stl_count_memory(stl, -threads_memory);
+
+    stl->stats.number_of_parts += directions.number_of_parts;
+    for(i = 0; i < stl->threads; i++) {
+      stl->stats.facets_reversed += directions.facets_reversed[i];
+      if(directions.errors[i]) stl->error = 1;
+    }
+  }
+  free(directions.first_facets);
+  free(directions.facets_reversed);
+  free(directions.errors);
+  stl_count_memory(stl, -(long long)STL_MAX(1, stl->stats.number_of_facets) *
+                   (long long)sizeof(int));
 }
 
 int
 stl_check_normal_vector(stl_file *stl, int facet_num, int normal_fix_flag) {
+  return stl_check_facet_normal(&stl->facet_start[facet_num], normal_fix_flag,
+                                &stl->stats.normals_fixed);
+}
+
+static int
+stl_check_facet_normal(stl_facet *facet, int normal_fix_flag,
+                       int *normals_fixed) {
   /* Returns 0 if the normal is within tolerance */
   /* Returns 1 if the normal is not within tolerance, but direction is OK */
   /* Returns 2 if the normal is not within tolerance and backwards */
@@ -202,9 +384,6 @@ stl_check_normal_vector(stl_file *stl, int facet_num, int normal_fix_flag) {
 
   float normal[3];
   float test_norm[3];
-  stl_facet *facet;
-
-  facet = &stl->facet_start[facet_num];
 
   stl_calculate_normal(normal, facet);
   stl_normalize_vector(normal);
@@ -232,7 +411,7 @@ stl_check_normal_vector(stl_file *stl, int facet_num, int normal_fix_flag) {
       facet->normal.x = normal[0];
       facet->normal.y = normal[1];
       facet->normal.z = normal[2];
-      stl->stats.normals_fixed += 1;
+      *normals_fixed += 1;
     }
     return 1;
   }
@@ -246,7 +425,7 @@ stl_check_normal_vector(stl_file *stl, int facet_num, int normal_fix_flag) {
       facet->normal.x = normal[0];
       facet->normal.y = normal[1];
       facet->normal.z = normal[2];
-      stl->stats.normals_fixed += 1;
+      *normals_fixed += 1;
     }
     return 2;
   }
@@ -254,7 +433,7 @@ stl_check_normal_vector(stl_file *stl, int facet_num, int normal_fix_flag) {
     facet->normal.x = normal[0];
     facet->normal.y = normal[1];
     facet->normal.z = normal[2];
-    stl->stats.normals_fixed += 1;
+    *normals_fixed += 1;
   }
   return 4;
 }
@@ -303,15 +482,43 @@ void stl_normalize_vector(float v[]) {
   v[2] *= factor;
 }
 
+static void
+stl_fix_normal_values_part(stl_file *stl, void *data, int thread,
+                           int threads) {
+  int *normals_fixed = (int*)data;
+  int i;
+  int begin;
+  int end;
+
+  stl_parallel_range(stl->stats.number_of_facets, thread, threads,
+                     &begin, &end);
+  for(i = begin; i < end; i++) {
+    stl_check_facet_normal(&stl->facet_start[i], 1, &normals_fixed[thread]);
+  }
+}
+
 void
 stl_fix_normal_values(stl_file *stl) {
+  int *normals_fixed = NULL;
   int i;
 
   if (stl->error) return;
 
-  for(i = 0; i < stl->stats.number_of_facets; i++) {
-    stl_check_normal_vector(stl, i, 1);
+  /* Every thread counts the fixed normals on its own. */
+  if(stl->threads > 1) {
+    normals_fixed = (int*)calloc(stl->threads, sizeof(int));
+  }
+  if(normals_fixed != NULL) {
+    stl_parallel_run(stl, stl_fix_normal_values_part, normals_fixed);
+    for(i = 0; i < stl->threads; i++) {
+      stl->stats.normals_fixed += normals_fixed[i];
+    }
+  } else {
+    for(i = 0; i < stl->stats.number_of_facets; i++) {
+      stl_check_normal_vector(stl, i, 1);
+    }
   }
+  free(normals_fixed);
 }
 
 void
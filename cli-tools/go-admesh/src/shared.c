@@ -20,11 +20,15 @@
  *           https://github.com/admesh/admesh/issues
  */
 
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "stl.h"
 
+static unsigned stl_get_hash_for_vertex(stl_vertex *vertex);
+
 void
 stl_invalidate_shared_vertices(stl_file *stl) {
   if (stl->error) return;
@@ -140,6 +144,120 @@ stl_generate_shared_vertices(stl_file *stl) {
   }
 }
 
+static unsigned
+stl_get_hash_for_vertex(stl_vertex *vertex) {
+  /* multiply-xorshift over the three words of the vertex */
+  uint32_t words[3];
+  uint64_t hash = 0;
+  int i;
+
+  memcpy(words, vertex, sizeof(words));
+  for(i = 0; i < 3; i++) {
+    hash = (hash ^ words[i]) * UINT64_C(0x9e3779b97f4a7c15);
+    hash ^= hash >> 29;
+  }
+  return (unsigned)(hash >> 32);
+}
+
+void
+stl_weld_shared_vertices(stl_file *stl) {
+  /* Builds the same v_shared and v_indices as stl_generate_shared_vertices,
+   * but the vertices with the same coordinates are welded with a hash table
+   * instead of walking around them through the neighbors.  So it doesn't
+   * need the neighbors list and works on a mesh that isn't repaired.  The
+   * vertices are numbered in the order they first appear, which is the
+   * same numbering as the one of stl_generate_shared_vertices on a
+   * connected, manifold mesh. */
+  int *table;
+  int *new_table;
+  int table_size;
+  int number_of_vertices = stl->stats.number_of_facets * 3;
+  stl_vertex *vertex;
+  stl_vertex *v_shared;
+  unsigned hash;
+  int i;
+  int j;
+  int k;
+
+  if (stl->error) return;
+
+  /* make sure this function is idempotent and does not leak memory */
+  stl_invalidate_shared_vertices(stl);
+
+  /* Every vertex can be a new one, so the output has room for all of them,
+     and the table grows when it gets half full. */
+  stl->v_indices = (v_indices_struct*)
+                   malloc(STL_MAX(1, stl->stats.number_of_facets) *
+                          sizeof(v_indices_struct));
+  stl->v_shared = (stl_vertex*)
+                  malloc(STL_MAX(1, number_of_vertices) * sizeof(stl_vertex));
+  table_size = 1024;
+  while(table_size < stl->stats.number_of_facets && table_size < (1 << 30)) {
+    table_size <<= 1;
+  }
+  table = (int*)malloc(table_size * sizeof(int));
+  if(stl->v_indices == NULL || stl->v_shared == NULL || table == NULL) {
+    perror("stl_weld_shared_vertices");
+    free(table);
+    stl_invalidate_shared_vertices(stl);
+    stl->error = 1;
+    return;
+  }
+  memset(table, -1, table_size * sizeof(int));
+  stl->stats.shared_vertices = 0;
+
+  for(i = 0; i < stl->stats.number_of_facets; i++) {
+    for(j = 0; j < 3; j++) {
+      vertex = &stl->facet_start[i].vertex[j];
+      hash = stl_get_hash_for_vertex(vertex) & (unsigned)(table_size - 1);
+      while(table[hash] != -1 &&
+            memcmp(&stl->v_shared[table[hash]], vertex, sizeof(stl_vertex))) {
+        hash = (hash + 1) & (unsigned)(table_size - 1);
+      }
+      if(table[hash] != -1) {
+        stl->v_indices[i].vertex[j] = table[hash];
+        continue;
+      }
+
+      table[hash] = stl->stats.shared_vertices;
+      stl->v_shared[stl->stats.shared_vertices] = *vertex;
+      stl->v_indices[i].vertex[j] = stl->stats.shared_vertices;
+      stl->stats.shared_vertices += 1;
+
+      if(stl->stats.shared_vertices * 2 > table_size &&
+         table_size < (1 << 30)) {
+        new_table = (int*)malloc(2 * table_size * sizeof(int));
+        if(new_table == NULL) {
+          perror("stl_weld_shared_vertices");
+          free(table);
+          stl_invalidate_shared_vertices(stl);
+          stl->error = 1;
+          return;
+        }
+        table_size *= 2;
+        memset(new_table, -1, table_size * sizeof(int));
+        for(k = 0; k < stl->stats.shared_vertices; k++) {
+          hash = stl_get_hash_for_vertex(&stl->v_shared[k]) &
+                 (unsigned)(table_size - 1);
+          while(new_table[hash] != -1) {
+            hash = (hash + 1) & (unsigned)(table_size - 1);
+          }
+          new_table[hash] = k;
+        }
+        free(table);
+        table = new_table;
+      }
+    }
+  }
+  free(table);
+
+  /* give back the room of the vertices that were welded */
+  stl->stats.shared_malloced = STL_MAX(1, stl->stats.shared_vertices);
+  v_shared = (stl_vertex*)realloc(stl->v_shared,
+                                  stl->stats.shared_malloced * sizeof(stl_vertex));
+  if(v_shared != NULL) stl->v_shared = v_shared;
+}
+
 void
 stl_write_off(stl_file *stl, char *file) {
   int i;
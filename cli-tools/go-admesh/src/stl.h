@@ -118,26 +118,74 @@ typedef struct {
   int           collisions;
   int           shared_vertices;
   int           shared_malloced;
+  /* bytes of the facet lists and the tables of the checks, now and at most */
+  long long     memory_allocated;
+  long long     memory_peak;
+  /* wall time of the stages of stl_repair, in seconds */
+  double        time_exact;
+  double        time_nearby;
+  double        time_remove_unconnected;
+  double        time_fill_holes;
+  double        time_reverse_all;
+  double        time_normal_directions;
+  double        time_normal_values;
+  double        time_volume;
+  double        time_verify_neighbors;
+  double        time_repair;
 } stl_stats;
 
 typedef struct {
   FILE          *fp;
+  const char    *memory;           /* input of stl_open_from_memory */
+  size_t        memory_size;
+  size_t        memory_position;
   stl_facet     *facet_start;
   stl_edge      *edge_start;
   stl_hash_edge **heads;
   stl_hash_edge *tail;
   int           M;
+  stl_hash_edge *edge_blocks;
+  stl_hash_edge *edge_free;
+  int           edge_block_size;
   stl_neighbors *neighbors_start;
   v_indices_struct *v_indices;
   stl_vertex    *v_shared;
   stl_stats     stats;
   char          error;
+  int           threads;
+  char          deterministic;
 } stl_file;
 
+/* Output of the writers that don't write to a file.  The data is grown with
+   realloc as needed and belongs to the caller, an empty buffer is all zeros. */
+typedef struct {
+  char          *data;
+  size_t        size;
+  size_t        allocated;
+} stl_buffer;
+
+/* Statistics of one part of the mesh, see stl_write_parts */
+typedef struct {
+  int           number_of_facets;
+  stl_vertex    max;
+  stl_vertex    min;
+  float         volume;
+  float         area;
+} stl_part_stats;
+
+/* Called on every thread of stl_parallel_run with the index of the thread */
+typedef void (*stl_parallel_function)(stl_file *stl, void *data,
+                                      int thread, int threads);
+
 
 extern void stl_open(stl_file *stl, char *file);
+extern void stl_open_from_memory(stl_file *stl, const char *data, size_t size);
+extern void stl_reopen(stl_file *stl, char *file);
 extern void stl_close(stl_file *stl);
 extern void stl_stats_out(stl_file *stl, FILE *file, char *input_file);
+extern void stl_stats_csv_header(FILE *file);
+extern void stl_stats_csv_out(stl_file *stl, FILE *file, const char *input_file);
+extern void stl_stats_json_out(stl_file *stl, FILE *file, const char *input_file);
 extern void stl_print_edges(stl_file *stl, FILE *file);
 extern void stl_print_neighbors(stl_file *stl, char *file);
 extern void stl_put_little_int(FILE *fp, int value_in);
@@ -145,8 +193,16 @@ extern void stl_put_little_float(FILE *fp, float value_in);
 extern void stl_write_ascii(stl_file *stl, const char *file, const char *label);
 extern void stl_write_binary(stl_file *stl, const char *file, const char *label);
 extern void stl_write_binary_block(stl_file *stl, FILE *fp);
+extern void stl_write_ascii_to_buffer(stl_file *stl, stl_buffer *buffer,
+                                      const char *label);
+extern void stl_write_binary_to_buffer(stl_file *stl, stl_buffer *buffer,
+                                       const char *label);
+extern stl_part_stats *stl_write_parts(stl_file *stl, const char *prefix,
+                                       const char *label, int *number_of_parts);
 extern void stl_check_facets_exact(stl_file *stl);
 extern void stl_check_facets_nearby(stl_file *stl, float tolerance);
+extern void stl_check_facets_nearby_iterations(stl_file *stl, float tolerance,
+    float increment, int iterations, int verbose_flag);
 extern void stl_remove_unconnected_facets(stl_file *stl);
 extern void stl_write_vertex(stl_file *stl, int facet, int vertex);
 extern void stl_write_facet(stl_file *stl, char *label, int facet);
@@ -156,6 +212,7 @@ extern void stl_write_quad_object(stl_file *stl, char *file);
 extern void stl_verify_neighbors(stl_file *stl);
 extern void stl_fill_holes(stl_file *stl);
 extern void stl_fix_normal_directions(stl_file *stl);
+extern int stl_label_parts(stl_file *stl, int *parts, int *first_facets);
 extern void stl_fix_normal_values(stl_file *stl);
 extern void stl_reverse_all_facets(stl_file *stl);
 extern void stl_translate(stl_file *stl, float x, float y, float z);
@@ -171,6 +228,7 @@ extern void stl_mirror_xz(stl_file *stl);
 extern void stl_open_merge(stl_file *stl, char *file);
 extern void stl_invalidate_shared_vertices(stl_file *stl);
 extern void stl_generate_shared_vertices(stl_file *stl);
+extern void stl_weld_shared_vertices(stl_file *stl);
 extern void stl_write_obj(stl_file *stl, char *file);
 extern void stl_write_off(stl_file *stl, char *file);
 extern void stl_write_dxf(stl_file *stl, char *file, char *label);
@@ -178,6 +236,8 @@ extern void stl_write_vrml(stl_file *stl, char *file);
 extern void stl_calculate_normal(float normal[], stl_facet *facet);
 extern void stl_normalize_vector(float v[]);
 extern void stl_calculate_volume(stl_file *stl);
+extern void stl_calculate_part_stats(stl_file *stl, int *facets, int count,
+                                     stl_part_stats *part);
 
 extern void stl_repair(stl_file *stl, int fixall_flag, int exact_flag, int tolerance_flag, float tolerance, int increment_flag, float increment, int nearby_flag, int iterations, int remove_unconnected_flag, int fill_holes_flag, int normal_directions_flag, int normal_values_flag, int reverse_all_flag, int verbose_flag);
 
@@ -190,6 +250,13 @@ extern void stl_reallocate(stl_file *stl);
 extern void stl_add_facet(stl_file *stl, stl_facet *new_facet);
 extern void stl_get_size(stl_file *stl);
 
+extern void stl_set_threads(stl_file *stl, int threads, int deterministic);
+extern void stl_parallel_run(stl_file *stl, stl_parallel_function function,
+                             void *data);
+extern void stl_parallel_range(int count, int thread, int threads,
+                               int *begin, int *end);
+extern void stl_count_memory(stl_file *stl, long long bytes);
+
 extern void stl_clear_error(stl_file *stl);
 extern int stl_get_error(stl_file *stl);
 extern void stl_exit_on_error(stl_file *stl);
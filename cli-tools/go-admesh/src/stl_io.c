@@ -20,6 +20,9 @@
  *           https://github.com/admesh/admesh/issues
  */
 
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "stl.h"
@@ -123,6 +126,214 @@ Backwards edges       : %5d\n", stl->stats.backwards_edges);
 Normals fixed         : %5d\n", stl->stats.normals_fixed);
 }
 
+/* The one line formats of the statistics, for reading them with a program */
+enum {stl_stats_csv_names, stl_stats_csv, stl_stats_csv_empty, stl_stats_json};
+
+static void
+stl_stats_string_out(FILE *file, int format, const char *value) {
+  const char *c;
+
+  if(format == stl_stats_json) {
+    putc('"', file);
+    for(c = value; *c != '\0'; c++) {
+      if(*c == '"' || *c == '\\') {
+        fprintf(file, "\\%c", *c);
+      } else if((unsigned char)*c < 0x20 || (unsigned char)*c >= 0x7f) {
+        /* the header may be anything, its bytes are taken as Latin-1 */
+        fprintf(file, "\\u%04x", (unsigned char)*c);
+      } else {
+        putc(*c, file);
+      }
+    }
+    putc('"', file);
+  } else if(strpbrk(value, ",\"\r\n") != NULL) {
+    putc('"', file);
+    for(c = value; *c != '\0'; c++) {
+      if(*c == '"') putc('"', file);
+      putc(*c, file);
+    }
+    putc('"', file);
+  } else {
+    fputs(value, file);
+  }
+}
+
+static void
+stl_stats_field_out(FILE *file, int format, int first, const char *name,
+                    const char *value, int quote) {
+  if(!first) putc(',', file);
+  if(format == stl_stats_csv_names) {
+    fputs(name, file);
+    return;
+  }
+  if(format == stl_stats_csv_empty) return;
+  if(format == stl_stats_json) fprintf(file, "\"%s\":", name);
+  if(quote) {
+    stl_stats_string_out(file, format, value);
+  } else {
+    fputs(value, file);
+  }
+}
+
+static void
+stl_stats_int_out(FILE *file, int format, const char *name, int value) {
+  char buffer[16];
+
+  sprintf(buffer, "%d", value);
+  stl_stats_field_out(file, format, 0, name, buffer, 0);
+}
+
+static void
+stl_stats_float_out(FILE *file, int format, const char *name, float value) {
+  char buffer[32];
+
+  if(format == stl_stats_json && !isfinite(value)) {
+    /* JSON has no nan or inf */
+    strcpy(buffer, "null");
+  } else {
+    /* enough digits to read back the same float */
+    sprintf(buffer, "%.9g", value);
+  }
+  stl_stats_field_out(file, format, 0, name, buffer, 0);
+}
+
+static void
+stl_stats_long_out(FILE *file, int format, const char *name, long long value) {
+  char buffer[32];
+
+  sprintf(buffer, "%lld", value);
+  stl_stats_field_out(file, format, 0, name, buffer, 0);
+}
+
+static void
+stl_stats_time_out(FILE *file, int format, const char *name, double value) {
+  char buffer[32];
+
+  /* in seconds, to the microsecond */
+  sprintf(buffer, "%.6f", value);
+  stl_stats_field_out(file, format, 0, name, buffer, 0);
+}
+
+static void
+stl_stats_line_out(stl_file *stl, FILE *file, int format,
+                   const char *input_file) {
+  int error = stl->error;
+
+  if(format == stl_stats_json) putc('{', file);
+  stl_stats_field_out(file, format, 1, "file", input_file, 1);
+  stl_stats_int_out(file, format, "error", error);
+  if(error && format == stl_stats_json) {
+    /* The statistics of a file that failed mean nothing */
+    fputs("}\n", file);
+    return;
+  }
+  if(error) {
+    /* Keep the columns of the header for a file that failed */
+    format = stl_stats_csv_empty;
+  }
+  stl_stats_field_out(file, format, 0, "type",
+                      stl->stats.type == binary ? "binary" : "ascii", 1);
+  stl_stats_field_out(file, format, 0, "header", stl->stats.header, 1);
+  stl_stats_float_out(file, format, "min_x", stl->stats.min.x);
+  stl_stats_float_out(file, format, "max_x", stl->stats.max.x);
+  stl_stats_float_out(file, format, "min_y", stl->stats.min.y);
+  stl_stats_float_out(file, format, "max_y", stl->stats.max.y);
+  stl_stats_float_out(file, format, "min_z", stl->stats.min.z);
+  stl_stats_float_out(file, format, "max_z", stl->stats.max.z);
+  stl_stats_float_out(file, format, "size_x", stl->stats.size.x);
+  stl_stats_float_out(file, format, "size_y", stl->stats.size.y);
+  stl_stats_float_out(file, format, "size_z", stl->stats.size.z);
+  stl_stats_float_out(file, format, "bounding_diameter",
+                      stl->stats.bounding_diameter);
+  stl_stats_float_out(file, format, "shortest_edge", stl->stats.shortest_edge);
+  stl_stats_int_out(file, format, "original_facets",
+                    stl->stats.original_num_facets);
+  stl_stats_int_out(file, format, "facets", stl->stats.number_of_facets);
+  stl_stats_int_out(file, format, "original_facets_1_bad_edge",
+                    stl->stats.facets_w_1_bad_edge);
+  stl_stats_int_out(file, format, "original_facets_2_bad_edges",
+                    stl->stats.facets_w_2_bad_edge);
+  stl_stats_int_out(file, format, "original_facets_3_bad_edges",
+                    stl->stats.facets_w_3_bad_edge);
+  stl_stats_int_out(file, format, "facets_1_bad_edge",
+                    stl->stats.connected_facets_2_edge -
+                    stl->stats.connected_facets_3_edge);
+  stl_stats_int_out(file, format, "facets_2_bad_edges",
+                    stl->stats.connected_facets_1_edge -
+                    stl->stats.connected_facets_2_edge);
+  stl_stats_int_out(file, format, "facets_3_bad_edges",
+                    stl->stats.number_of_facets -
+                    stl->stats.connected_facets_1_edge);
+  stl_stats_int_out(file, format, "parts", stl->stats.number_of_parts);
+  stl_stats_float_out(file, format, "volume", stl->stats.volume);
+  stl_stats_int_out(file, format, "degenerate_facets",
+                    stl->stats.degenerate_facets);
+  stl_stats_int_out(file, format, "edges_fixed", stl->stats.edges_fixed);
+  stl_stats_int_out(file, format, "facets_removed", stl->stats.facets_removed);
+  stl_stats_int_out(file, format, "facets_added", stl->stats.facets_added);
+  stl_stats_int_out(file, format, "facets_reversed",
+                    stl->stats.facets_reversed);
+  stl_stats_int_out(file, format, "backwards_edges",
+                    stl->stats.backwards_edges);
+  stl_stats_int_out(file, format, "normals_fixed", stl->stats.normals_fixed);
+  stl_stats_int_out(file, format, "connected_edges",
+                    stl->stats.connected_edges);
+  stl_stats_int_out(file, format, "connected_facets_1_edge",
+                    stl->stats.connected_facets_1_edge);
+  stl_stats_int_out(file, format, "connected_facets_2_edges",
+                    stl->stats.connected_facets_2_edge);
+  stl_stats_int_out(file, format, "connected_facets_3_edges",
+                    stl->stats.connected_facets_3_edge);
+  stl_stats_int_out(file, format, "edges_malloced", stl->stats.malloced);
+  stl_stats_int_out(file, format, "edges_freed", stl->stats.freed);
+  stl_stats_int_out(file, format, "collisions", stl->stats.collisions);
+  stl_stats_int_out(file, format, "facets_malloced",
+                    stl->stats.facets_malloced);
+  stl_stats_int_out(file, format, "shared_vertices",
+                    stl->stats.shared_vertices);
+  stl_stats_int_out(file, format, "shared_malloced",
+                    stl->stats.shared_malloced);
+  stl_stats_long_out(file, format, "memory_peak", stl->stats.memory_peak);
+  stl_stats_time_out(file, format, "time_exact", stl->stats.time_exact);
+  stl_stats_time_out(file, format, "time_nearby", stl->stats.time_nearby);
+  stl_stats_time_out(file, format, "time_remove_unconnected",
+                     stl->stats.time_remove_unconnected);
+  stl_stats_time_out(file, format, "time_fill_holes",
+                     stl->stats.time_fill_holes);
+  stl_stats_time_out(file, format, "time_reverse_all",
+                     stl->stats.time_reverse_all);
+  stl_stats_time_out(file, format, "time_normal_directions",
+                     stl->stats.time_normal_directions);
+  stl_stats_time_out(file, format, "time_normal_values",
+                     stl->stats.time_normal_values);
+  stl_stats_time_out(file, format, "time_volume", stl->stats.time_volume);
+  stl_stats_time_out(file, format, "time_verify_neighbors",
+                     stl->stats.time_verify_neighbors);
+  stl_stats_time_out(file, format, "time_repair", stl->stats.time_repair);
+  fputs(format == stl_stats_json ? "}\n" : "\n", file);
+}
+
+void
+stl_stats_csv_header(FILE *file) {
+  stl_file stl;
+
+  /* The names are written by the same code as the values, so that the
+     columns always match */
+  stl_initialize(&stl);
+  stl_stats_line_out(&stl, file, stl_stats_csv_names, NULL);
+}
+
+void
+stl_stats_csv_out(stl_file *stl, FILE *file, const char *input_file) {
+  /* One line per file, also for a file that couldn't be read */
+  stl_stats_line_out(stl, file, stl_stats_csv, input_file);
+}
+
+void
+stl_stats_json_out(stl_file *stl, FILE *file, const char *input_file) {
+  stl_stats_line_out(stl, file, stl_stats_json, input_file);
+}
+
 void
 stl_write_ascii(stl_file *stl, const char *file, const char *label) {
   int       i;
@@ -169,6 +380,89 @@ stl_write_ascii(stl_file *stl, const char *file, const char *label) {
   fclose(fp);
 }
 
+static char *
+stl_buffer_reserve(stl_file *stl, stl_buffer *buffer, size_t size) {
+  /* Makes room for size more bytes and returns where they go */
+  size_t allocated;
+  char   *data;
+
+  if(buffer->size + size > buffer->allocated) {
+    allocated = STL_MAX(4096, buffer->allocated);
+    while(allocated < buffer->size + size) {
+      allocated *= 2;
+    }
+    data = (char*)realloc(buffer->data, allocated);
+    if(data == NULL) {
+      perror("stl_buffer_reserve");
+      stl->error = 1;
+      return NULL;
+    }
+    buffer->data = data;
+    buffer->allocated = allocated;
+  }
+  return buffer->data + buffer->size;
+}
+
+static void
+stl_buffer_printf(stl_file *stl, stl_buffer *buffer, const char *format, ...) {
+  va_list args;
+  char    *data;
+  int     length;
+
+  if (stl->error) return;
+
+  /* Most lines fit in the room that is left, otherwise the buffer grows
+     to the length of the line and the line is printed again. */
+  data = stl_buffer_reserve(stl, buffer, 128);
+  if(data == NULL) return;
+  va_start(args, format);
+  length = vsnprintf(data, buffer->allocated - buffer->size, format, args);
+  va_end(args);
+  if(length < 0) {
+    stl->error = 1;
+    return;
+  }
+  if((size_t)length >= buffer->allocated - buffer->size) {
+    data = stl_buffer_reserve(stl, buffer, length + 1);
+    if(data == NULL) return;
+    va_start(args, format);
+    vsnprintf(data, length + 1, format, args);
+    va_end(args);
+  }
+  buffer->size += length;
+}
+
+void
+stl_write_ascii_to_buffer(stl_file *stl, stl_buffer *buffer,
+                          const char *label) {
+  /* Appends the same text as stl_write_ascii writes to a file */
+  int i;
+
+  if (stl->error) return;
+
+  stl_buffer_printf(stl, buffer, "solid  %s\n", label);
+
+  for(i = 0; i < stl->stats.number_of_facets && !stl->error; i++) {
+    stl_buffer_printf(stl, buffer, "  facet normal % .8E % .8E % .8E\n",
+                      stl->facet_start[i].normal.x, stl->facet_start[i].normal.y,
+                      stl->facet_start[i].normal.z);
+    stl_buffer_printf(stl, buffer, "    outer loop\n");
+    stl_buffer_printf(stl, buffer, "      vertex % .8E % .8E % .8E\n",
+                      stl->facet_start[i].vertex[0].x, stl->facet_start[i].vertex[0].y,
+                      stl->facet_start[i].vertex[0].z);
+    stl_buffer_printf(stl, buffer, "      vertex % .8E % .8E % .8E\n",
+                      stl->facet_start[i].vertex[1].x, stl->facet_start[i].vertex[1].y,
+                      stl->facet_start[i].vertex[1].z);
+    stl_buffer_printf(stl, buffer, "      vertex % .8E % .8E % .8E\n",
+                      stl->facet_start[i].vertex[2].x, stl->facet_start[i].vertex[2].y,
+                      stl->facet_start[i].vertex[2].z);
+    stl_buffer_printf(stl, buffer, "    endloop\n");
+    stl_buffer_printf(stl, buffer, "  endfacet\n");
+  }
+
+  stl_buffer_printf(stl, buffer, "endsolid  %s\n", label);
+}
+
 void
 stl_print_neighbors(stl_file *stl, char *file) {
   int i;
@@ -293,6 +587,244 @@ stl_write_binary(stl_file *stl, const char *file, const char *label) {
   fclose(fp);
 }
 
+static void
+stl_put_little_uint32(unsigned char *data, uint32_t value) {
+  data[0] = value & 0xFF;
+  data[1] = (value >> 0x08) & 0xFF;
+  data[2] = (value >> 0x10) & 0xFF;
+  data[3] = (value >> 0x18) & 0xFF;
+}
+
+void
+stl_write_binary_to_buffer(stl_file *stl, stl_buffer *buffer,
+                           const char *label) {
+  /* Appends the same bytes as stl_write_binary writes to a file */
+  unsigned char *data;
+  float         *facet_floats;
+  uint32_t      value;
+  size_t        length;
+  int           i;
+  int           j;
+
+  if (stl->error) return;
+
+  data = (unsigned char*)stl_buffer_reserve(stl, buffer, HEADER_SIZE +
+                                            (size_t)stl->stats.number_of_facets *
+                                            SIZEOF_STL_FACET);
+  if(data == NULL) return;
+
+  /* the label is cut to the size of the header, like in the file */
+  length = STL_MIN(strlen(label), LABEL_SIZE);
+  memcpy(data, label, length);
+  memset(data + length, 0, LABEL_SIZE - length);
+  stl_put_little_uint32(data + LABEL_SIZE, stl->stats.number_of_facets);
+  data += HEADER_SIZE;
+
+  for(i = 0; i < stl->stats.number_of_facets; i++) {
+    facet_floats = &stl->facet_start[i].normal.x;
+    for(j = 0; j < 12; j++) {
+      memcpy(&value, &facet_floats[j], sizeof(value));
+      stl_put_little_uint32(data + j * 4, value);
+    }
+    data[48] = stl->facet_start[i].extra[0];
+    data[49] = stl->facet_start[i].extra[1];
+    data += SIZEOF_STL_FACET;
+  }
+  buffer->size += HEADER_SIZE + (size_t)stl->stats.number_of_facets *
+                  SIZEOF_STL_FACET;
+}
+
+/* number of facets written at once by stl_write_parts */
+#define STL_WRITE_BLOCK_FACETS  4096
+
+typedef struct {
+  const char     *prefix;
+  const char     *label;
+  int            *offsets;  /* the facets of part i are from offsets[i] */
+  int            *facets;   /* the facets, sorted by part */
+  int             number_of_parts;
+  stl_part_stats *parts;
+  char           *errors;   /* set if a thread couldn't write a part */
+} stl_parts_data;
+
+static int
+stl_write_part(FILE *fp, stl_file *stl, int *facets, int count,
+               const char *label, unsigned char *block) {
+  /* Writes the facets as a binary STL file, the same way as
+     stl_write_binary_to_buffer */
+  unsigned char *data;
+  float         *facet_floats;
+  uint32_t      value;
+  size_t        length;
+  int           i;
+  int           j;
+  int           k;
+
+  length = STL_MIN(strlen(label), LABEL_SIZE);
+  memcpy(block, label, length);
+  memset(block + length, 0, LABEL_SIZE - length);
+  stl_put_little_uint32(block + LABEL_SIZE, count);
+  if(fwrite(block, 1, HEADER_SIZE, fp) != HEADER_SIZE) return 0;
+
+  for(i = 0; i < count; i += STL_WRITE_BLOCK_FACETS) {
+    length = STL_MIN(STL_WRITE_BLOCK_FACETS, count - i);
+    data = block;
+    for(j = 0; j < (int)length; j++) {
+      facet_floats = &stl->facet_start[facets[i + j]].normal.x;
+      for(k = 0; k < 12; k++) {
+        memcpy(&value, &facet_floats[k], sizeof(value));
+        stl_put_little_uint32(data + k * 4, value);
+      }
+      data[48] = stl->facet_start[facets[i + j]].extra[0];
+      data[49] = stl->facet_start[facets[i + j]].extra[1];
+      data += SIZEOF_STL_FACET;
+    }
+    if(fwrite(block, SIZEOF_STL_FACET, length, fp) != length) return 0;
+  }
+  return 1;
+}
+
+static void
+stl_write_parts_error(const char *format, const char *name) {
+  char *error_msg;
+
+  error_msg = (char*)
+              malloc(81 + strlen(name)); /* Allow 80 chars+file size for message */
+  if(error_msg == NULL) {
+    perror(name);
+    return;
+  }
+  sprintf(error_msg, format, name);
+  perror(error_msg);
+  free(error_msg);
+}
+
+static void
+stl_write_parts_thread(stl_file *stl, void *data, int thread, int threads) {
+  /* Every thread takes every threads-th part, so that a few big parts
+     don't all end up on one thread */
+  stl_parts_data *parts = (stl_parts_data*)data;
+  unsigned char  *block;
+  char           *name;
+  FILE           *fp;
+  int             written;
+  int             i;
+
+  block = (unsigned char*)malloc(STL_WRITE_BLOCK_FACETS * SIZEOF_STL_FACET);
+  name = (char*)malloc(strlen(parts->prefix) + 16);
+  if(block == NULL || name == NULL) {
+    perror("stl_write_parts");
+    parts->errors[thread] = 1;
+  } else {
+    for(i = thread; i < parts->number_of_parts; i += threads) {
+      stl_calculate_part_stats(stl, parts->facets + parts->offsets[i],
+                               parts->offsets[i + 1] - parts->offsets[i],
+                               &parts->parts[i]);
+      sprintf(name, "%s%d.stl", parts->prefix, i + 1);
+      fp = fopen(name, "wb");
+      if(fp == NULL) {
+        stl_write_parts_error("stl_write_parts: Couldn't open %s for writing",
+                              name);
+        parts->errors[thread] = 1;
+        break;
+      }
+      written = stl_write_part(fp, stl, parts->facets + parts->offsets[i],
+                               parts->offsets[i + 1] - parts->offsets[i],
+                               parts->label, block);
+      if(fclose(fp) != 0 || !written) {
+        stl_write_parts_error("stl_write_parts: Couldn't write %s", name);
+        parts->errors[thread] = 1;
+        break;
+      }
+    }
+  }
+  free(block);
+  free(name);
+}
+
+static void
+stl_sort_parts(stl_file *stl, int *labels, stl_parts_data *parts) {
+  /* Sorts the facets by part, in their order within a part, and sets the
+     offsets of the parts */
+  int i;
+
+  for(i = 0; i < stl->stats.number_of_facets; i++) {
+    parts->offsets[labels[i] + 1]++;
+  }
+  for(i = 0; i < parts->number_of_parts; i++) {
+    parts->offsets[i + 1] += parts->offsets[i];
+  }
+  for(i = 0; i < stl->stats.number_of_facets; i++) {
+    parts->facets[parts->offsets[labels[i]]++] = i;
+  }
+  /* every offset moved to the end of its part, move them back */
+  for(i = parts->number_of_parts; i > 0; i--) {
+    parts->offsets[i] = parts->offsets[i - 1];
+  }
+  parts->offsets[0] = 0;
+}
+
+stl_part_stats *
+stl_write_parts(stl_file *stl, const char *prefix, const char *label,
+                int *number_of_parts) {
+  /* Writes every part as its own binary STL file, called prefix followed
+     by the number of the part, from 1, and .stl.  The parts are the facets
+     connected through the neighbors, so one of the checks must have run.
+     Returns the statistics of every part, in a list the caller frees, and
+     their number in number_of_parts. */
+  stl_parts_data parts;
+  int           *labels;
+  long long      memory;
+  int            i;
+
+  *number_of_parts = 0;
+  if (stl->error) return NULL;
+
+  memory = 2 * (long long)STL_MAX(1, stl->stats.number_of_facets) *
+           (long long)sizeof(int);
+  labels = (int*)malloc(STL_MAX(1, stl->stats.number_of_facets) * sizeof(int));
+  parts.facets = (int*)malloc(STL_MAX(1, stl->stats.number_of_facets) *
+                              sizeof(int));
+  parts.errors = (char*)calloc(stl->threads, sizeof(char));
+  parts.offsets = NULL;
+  parts.parts = NULL;
+  if(labels == NULL || parts.facets == NULL || parts.errors == NULL) {
+    perror("stl_write_parts");
+    stl->error = 1;
+  } else {
+    stl_count_memory(stl, memory);
+    parts.number_of_parts = stl_label_parts(stl, labels, NULL);
+    if(parts.number_of_parts >= 0) {
+      parts.offsets = (int*)calloc(parts.number_of_parts + 1, sizeof(int));
+      parts.parts = (stl_part_stats*)calloc(STL_MAX(1, parts.number_of_parts),
+                                            sizeof(stl_part_stats));
+      if(parts.offsets == NULL || parts.parts == NULL) {
+        perror("stl_write_parts");
+        stl->error = 1;
+      } else {
+        stl_sort_parts(stl, labels, &parts);
+        parts.prefix = prefix;
+        parts.label = label;
+        stl_parallel_run(stl, stl_write_parts_thread, &parts);
+        for(i = 0; i < stl->threads; i++) {
+          if(parts.errors[i]) stl->error = 1;
+        }
+      }
+    }
+    stl_count_memory(stl, -memory);
+  }
+  free(labels);
+  free(parts.facets);
+  free(parts.offsets);
+  free(parts.errors);
+  if(stl->error) {
+    free(parts.parts);
+    return NULL;
+  }
+  *number_of_parts = parts.number_of_parts;
+  return parts.parts;
+}
+
 void
 stl_write_vertex(stl_file *stl, int facet, int vertex) {
   if (stl->error) return;
@@ -29,12 +29,38 @@
 #include "portable_endian.h"
 #include "stl.h"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define STL_HAVE_SSE
+#endif
+
 #if !defined(SEEK_SET)
 #define SEEK_SET 0
 #define SEEK_CUR 1
 #define SEEK_END 2
 #endif
 
+/* number of facets read from a binary file at once */
+#define STL_READ_BLOCK_FACETS  4096
+/* size of the buffer used for tokenizing ASCII files */
+#define STL_ASCII_BUFFER_SIZE  65536
+#define STL_ASCII_TOKEN_SIZE   64
+
+typedef struct {
+  stl_file *stl;
+  char   *buffer;
+  size_t  position;
+  size_t  length;
+  char    token[STL_ASCII_TOKEN_SIZE];
+} stl_ascii_reader;
+
+static void stl_count_input_facets(stl_file *stl, const char *name);
+static size_t stl_read_input(stl_file *stl, void *buffer, size_t size);
+static void stl_seek_input(stl_file *stl, long offset);
+static int stl_read_binary(stl_file *stl, int first_facet, int first);
+static int stl_read_ascii(stl_file *stl, int first_facet, int first);
+static void stl_facets_min_max(stl_file *stl, int first_facet, int last_facet);
+
 void
 stl_open(stl_file *stl, char *file) {
   stl_initialize(stl);
@@ -44,10 +70,26 @@ stl_open(stl_file *stl, char *file) {
   if (!stl->error) fclose(stl->fp);
 }
 
+void
+stl_open_from_memory(stl_file *stl, const char *data, size_t size) {
+  /* Same as stl_open, but the STL file is already in memory.  The data is
+     only read while opening, the caller keeps it. */
+  stl_initialize(stl);
+  stl->memory = data;
+  stl->memory_size = size;
+  stl->memory_position = 0;
+  stl_count_input_facets(stl, "from memory");
+  stl_allocate(stl);
+  stl_read(stl, 0, 1);
+  stl->memory = NULL;
+}
+
 
 void
 stl_initialize(stl_file *stl) {
   stl->error = 0;
+  /* some of the statistics are only set by the checks, start them all at 0 */
+  memset(&stl->stats, 0, sizeof(stl->stats));
   stl->stats.backwards_edges = 0;
   stl->stats.degenerate_facets = 0;
   stl->stats.edges_fixed  = 0;
@@ -61,21 +103,43 @@ stl_initialize(stl_file *stl) {
   stl->stats.facets_malloced = 0;
   stl->stats.volume = -1.0;
 
+  stl->threads = 1;
+  stl->deterministic = 0;
+
+  stl->fp = NULL;
+  stl->memory = NULL;
+  stl->memory_size = 0;
+  stl->memory_position = 0;
+
   stl->neighbors_start = NULL;
   stl->facet_start = NULL;
   stl->v_indices = NULL;
   stl->v_shared = NULL;
 }
 
+static size_t
+stl_read_input(stl_file *stl, void *buffer, size_t size) {
+  /* Reads from the file, or from the memory of stl_open_from_memory */
+  if(stl->memory == NULL) {
+    return fread(buffer, 1, size, stl->fp);
+  }
+  size = STL_MIN(size, stl->memory_size - stl->memory_position);
+  memcpy(buffer, stl->memory + stl->memory_position, size);
+  stl->memory_position += size;
+  return size;
+}
+
+static void
+stl_seek_input(stl_file *stl, long offset) {
+  if(stl->memory == NULL) {
+    fseek(stl->fp, offset, SEEK_SET);
+  } else {
+    stl->memory_position = STL_MIN((size_t)offset, stl->memory_size);
+  }
+}
+
 void
 stl_count_facets(stl_file *stl, char *file) {
-  long           file_size;
-  uint32_t       header_num_facets;
-  int            num_facets;
-  int            i, j;
-  size_t         s;
-  unsigned char  chtest[128];
-  int            num_lines = 1;
   char           *error_msg;
 
   if (stl->error) return;
@@ -92,13 +156,34 @@ stl_count_facets(stl_file *stl, char *file) {
     stl->error = 1;
     return;
   }
+  stl_count_input_facets(stl, file);
+}
+
+static void
+stl_count_input_facets(stl_file *stl, const char *name) {
+  long           file_size;
+  uint32_t       header_num_facets;
+  int            num_facets;
+  int            i, j;
+  size_t         s;
+  char           c;
+  unsigned char  chtest[128];
+  unsigned char  chbuffer[4096];
+  int            num_lines = 1;
+
+  if (stl->error) return;
+
   /* Find size of file */
-  fseek(stl->fp, 0, SEEK_END);
-  file_size = ftell(stl->fp);
+  if(stl->memory == NULL) {
+    fseek(stl->fp, 0, SEEK_END);
+    file_size = ftell(stl->fp);
+  } else {
+    file_size = (long)stl->memory_size;
+  }
 
   /* Check for binary or ASCII file */
-  fseek(stl->fp, HEADER_SIZE, SEEK_SET);
-  if (!fread(chtest, sizeof(chtest), 1, stl->fp)) {
+  stl_seek_input(stl, HEADER_SIZE);
+  if (stl_read_input(stl, chtest, sizeof(chtest)) != sizeof(chtest)) {
     perror("The input is an empty file");
     stl->error = 1;
     return;
@@ -110,7 +195,7 @@ stl_count_facets(stl_file *stl, char *file) {
       break;
     }
   }
-  rewind(stl->fp);
+  stl_seek_input(stl, 0);
 
   /* Get the header and the number of facets in the .STL file */
   /* If the .STL file is binary, then do the following */
@@ -118,19 +203,19 @@ stl_count_facets(stl_file *stl, char *file) {
     /* Test if the STL file has the right size  */
     if(((file_size - HEADER_SIZE) % SIZEOF_STL_FACET != 0)
         || (file_size < STL_MIN_FILE_SIZE)) {
-      fprintf(stderr, "The file %s has the wrong size.\n", file);
+      fprintf(stderr, "The file %s has the wrong size.\n", name);
       stl->error = 1;
       return;
     }
     num_facets = (file_size - HEADER_SIZE) / SIZEOF_STL_FACET;
 
     /* Read the header */
-    if (fread(stl->stats.header, LABEL_SIZE, 1, stl->fp) > 79) {
+    if (stl_read_input(stl, stl->stats.header, LABEL_SIZE) > 79) {
       stl->stats.header[80] = '\0';
     }
 
     /* Read the int following the header.  This should contain # of facets */
-    if((!fread(&header_num_facets, sizeof(uint32_t), 1, stl->fp)) || (uint32_t)num_facets != le32toh(header_num_facets)) {
+    if((stl_read_input(stl, &header_num_facets, sizeof(uint32_t)) != sizeof(uint32_t)) || (uint32_t)num_facets != le32toh(header_num_facets)) {
       fprintf(stderr,
               "Warning: File size doesn't match number of facets in the header\n");
     }
@@ -138,7 +223,7 @@ stl_count_facets(stl_file *stl, char *file) {
   /* Otherwise, if the .STL file is ASCII, then do the following */
   else {
     /* Reopen the file in text mode (for getting correct newlines on Windows) */
-    if (freopen(file, "r", stl->fp) == NULL) {
+    if (stl->memory == NULL && freopen(name, "r", stl->fp) == NULL) {
       perror("Could not reopen the file, something went wrong");
       stl->error = 1;
       return;
@@ -146,20 +231,23 @@ stl_count_facets(stl_file *stl, char *file) {
 
     /* Find the number of facets */
     j = 0;
-    for(i = 0; i < file_size ; i++) {
-      j++;
-      if(getc(stl->fp) == '\n') {
-        if(j > 4) { /* don't count short lines */
-          num_lines++;
+    while((s = stl_read_input(stl, chbuffer, sizeof(chbuffer))) > 0) {
+      for(i = 0; i < (int)s; i++) {
+        j++;
+        if(chbuffer[i] == '\n') {
+          if(j > 4) { /* don't count short lines */
+            num_lines++;
+          }
+          j = 0;
         }
-        j = 0;
       }
     }
-    rewind(stl->fp);
+    stl_seek_input(stl, 0);
 
     /* Get the header */
-    for(i = 0;
-        (i < 80) && (stl->stats.header[i] = getc(stl->fp)) != '\n'; i++);
+    for(i = 0; (i < 80) && stl_read_input(stl, &c, 1) == 1 && c != '\n'; i++) {
+      stl->stats.header[i] = c;
+    }
     stl->stats.header[i] = '\0'; /* Lose the '\n' */
     stl->stats.header[80] = '\0';
 
@@ -183,6 +271,8 @@ stl_allocate(stl_file *stl) {
   stl->neighbors_start = (stl_neighbors*)
                          calloc(stl->stats.number_of_facets, sizeof(stl_neighbors));
   if(stl->neighbors_start == NULL) perror("stl_initialize");
+  stl_count_memory(stl, (long long)stl->stats.facets_malloced *
+                   (sizeof(stl_facet) + sizeof(stl_neighbors)));
 }
 
 void
@@ -224,6 +314,7 @@ stl_open_merge(stl_file *stl, char *file_to_merge) {
      that this isn't our first time so we should augment stats like min and max
      instead of erasing them. */
   stl_read(stl, num_facets_so_far, 0);
+  if(stl->fp != NULL) fclose(stl->fp);
 
   /* Restore the stl information we overwrote (for stl_read) so that it still accurately
      reflects the subject part: */
@@ -233,18 +324,74 @@ stl_open_merge(stl_file *stl, char *file_to_merge) {
 
 extern void
 stl_reallocate(stl_file *stl) {
+  int facets_malloced;
+
   if (stl->error) return;
+  /* Nothing to do if the facets still fit, otherwise grow by at least half
+     so that a run of merges doesn't copy the facets every time */
+  if(stl->stats.facets_malloced >= stl->stats.number_of_facets) return;
+  facets_malloced = STL_MAX(stl->stats.number_of_facets,
+                            stl->stats.facets_malloced + stl->stats.facets_malloced / 2);
+
   /*  Reallocate more memory for the .STL file(s) */
-  stl->facet_start = (stl_facet*)realloc(stl->facet_start, stl->stats.number_of_facets *
+  stl->facet_start = (stl_facet*)realloc(stl->facet_start, facets_malloced *
                                          sizeof(stl_facet));
-  if(stl->facet_start == NULL) perror("stl_initialize");
-  stl->stats.facets_malloced = stl->stats.number_of_facets;
+  if(stl->facet_start == NULL) {
+    perror("stl_reallocate");
+    stl->error = 1;
+    return;
+  }
 
   /* Reallocate more memory for the neighbors list */
   stl->neighbors_start = (stl_neighbors*)
-                         realloc(stl->neighbors_start, stl->stats.number_of_facets *
+                         realloc(stl->neighbors_start, facets_malloced *
                                  sizeof(stl_neighbors));
-  if(stl->facet_start == NULL) perror("stl_initialize");
+  if(stl->neighbors_start == NULL) {
+    perror("stl_reallocate");
+    stl->error = 1;
+    return;
+  }
+  stl_count_memory(stl, (long long)(facets_malloced - stl->stats.facets_malloced) *
+                   (sizeof(stl_facet) + sizeof(stl_neighbors)));
+  stl->stats.facets_malloced = facets_malloced;
+}
+
+void
+stl_reopen(stl_file *stl, char *file) {
+  /* Same as stl_open, but for an stl that was opened before and is read
+     again with another file.  The facet and neighbor lists are kept and only
+     grown when the new file doesn't fit, so that many files can be processed
+     one after the other without allocating them again. */
+  stl_facet     *facet_start = stl->facet_start;
+  stl_neighbors *neighbors_start = stl->neighbors_start;
+  int            facets_malloced = stl->stats.facets_malloced;
+  int            threads = stl->threads;
+  char           deterministic = stl->deterministic;
+
+  if(stl->v_indices != NULL) free(stl->v_indices);
+  if(stl->v_shared != NULL) free(stl->v_shared);
+
+  stl_initialize(stl);
+  stl->facet_start = facet_start;
+  stl->neighbors_start = neighbors_start;
+  stl->stats.facets_malloced = facets_malloced;
+  stl_count_memory(stl, (long long)facets_malloced *
+                   (sizeof(stl_facet) + sizeof(stl_neighbors)));
+  stl->threads = threads;
+  stl->deterministic = deterministic;
+
+  stl_count_facets(stl, file);
+  stl_reallocate(stl);
+  if(!stl->error) {
+    memset(stl->facet_start, 0, stl->stats.number_of_facets * sizeof(stl_facet));
+    memset(stl->neighbors_start, 0,
+           stl->stats.number_of_facets * sizeof(stl_neighbors));
+  }
+  stl_read(stl, 0, 1);
+  if(stl->fp != NULL) {
+    fclose(stl->fp);
+    stl->fp = NULL;
+  }
 }
 
 
@@ -253,85 +400,253 @@ stl_reallocate(stl_file *stl) {
    time running this for the stl and therefore we should reset our max and min stats. */
 void
 stl_read(stl_file *stl, int first_facet, int first) {
-  stl_facet facet;
-  int   i, j;
-  const int facet_float_length = 12;
-  float *facet_floats[12];
-  char facet_buffer[12 * sizeof(float)];
-  uint32_t endianswap_buffer;  /* for byteswapping operations */
-
-  facet.extra[0] = 0;
-  facet.extra[1] = 0;
-
-  facet_floats[0] = &facet.normal.x;
-  facet_floats[1] = &facet.normal.y;
-  facet_floats[2] = &facet.normal.z;
-  facet_floats[3] = &facet.vertex[0].x;
-  facet_floats[4] = &facet.vertex[0].y;
-  facet_floats[5] = &facet.vertex[0].z;
-  facet_floats[6] = &facet.vertex[1].x;
-  facet_floats[7] = &facet.vertex[1].y;
-  facet_floats[8] = &facet.vertex[1].z;
-  facet_floats[9] = &facet.vertex[2].x;
-  facet_floats[10] = &facet.vertex[2].y;
-  facet_floats[11] = &facet.vertex[2].z;
-
   if (stl->error) return;
 
   if(stl->stats.type == binary) {
-    fseek(stl->fp, HEADER_SIZE, SEEK_SET);
+    if(!stl_read_binary(stl, first_facet, first)) {
+      perror("Cannot read facet");
+      stl->error = 1;
+      return;
+    }
   } else {
-    rewind(stl->fp);
-    /* Skip the first line of the file */
-    while(getc(stl->fp) != '\n');
+    if(!stl_read_ascii(stl, first_facet, first)) {
+      perror("Something is syntactically very wrong with this ASCII STL!");
+      stl->error = 1;
+      return;
+    }
   }
 
-  for(i = first_facet; i < stl->stats.number_of_facets; i++) {
-    if(stl->stats.type == binary)
-      /* Read a single facet from a binary .STL file */
-    {
-      if(fread(facet_buffer, sizeof(facet_buffer), 1, stl->fp)
-         + fread(&facet.extra, sizeof(char), 2, stl->fp) != 3) {
-        perror("Cannot read facet");
-        stl->error = 1;
-        return;
-      }
+  stl->stats.size.x = stl->stats.max.x - stl->stats.min.x;
+  stl->stats.size.y = stl->stats.max.y - stl->stats.min.y;
+  stl->stats.size.z = stl->stats.max.z - stl->stats.min.z;
+  stl->stats.bounding_diameter = sqrt(
+                                   stl->stats.size.x * stl->stats.size.x +
+                                   stl->stats.size.y * stl->stats.size.y +
+                                   stl->stats.size.z * stl->stats.size.z
+                                 );
+}
+
+static int
+stl_host_is_little_endian(void) {
+  const uint32_t one = 1;
+  return *(const unsigned char *)&one == 1;
+}
+
+static int
+stl_read_binary(stl_file *stl, int first_facet, int first) {
+  /* The facets are read in blocks and converted from the packed 50 byte
+     records.  On little endian hosts the floats are copied as they are. */
+  char     *buffer;
+  char     *record;
+  stl_facet *facet;
+  uint32_t  endianswap_buffer;  /* for byteswapping operations */
+  int       little_endian;
+  int       count;
+  int       i, j;
+
+  buffer = (char*)malloc(STL_READ_BLOCK_FACETS * SIZEOF_STL_FACET);
+  if(buffer == NULL) return 0;
+
+  little_endian = stl_host_is_little_endian();
+  stl_seek_input(stl, HEADER_SIZE);
+
+  for(i = first_facet; i < stl->stats.number_of_facets; i += count) {
+    count = STL_MIN(STL_READ_BLOCK_FACETS, stl->stats.number_of_facets - i);
+    if(stl_read_input(stl, buffer, (size_t)count * SIZEOF_STL_FACET) !=
+        (size_t)count * SIZEOF_STL_FACET) {
+      free(buffer);
+      return 0;
+    }
 
-      for(j = 0; j < facet_float_length; j++) {
-        /* convert LE float to host byte order */
-        memcpy(&endianswap_buffer, facet_buffer + j * sizeof(float), 4);
-        endianswap_buffer = le32toh(endianswap_buffer);
-        memcpy(facet_floats[j], &endianswap_buffer, 4);
+    for(j = 0; j < count; j++) {
+      record = buffer + j * SIZEOF_STL_FACET;
+      facet = &stl->facet_start[i + j];
+      if(little_endian) {
+        memcpy(facet, record, SIZEOF_STL_FACET);
+      } else {
+        float *facet_floats = &facet->normal.x;
+        int k;
+        for(k = 0; k < 12; k++) {
+          /* convert LE float to host byte order */
+          memcpy(&endianswap_buffer, record + k * sizeof(float), 4);
+          endianswap_buffer = le32toh(endianswap_buffer);
+          memcpy(&facet_floats[k], &endianswap_buffer, 4);
+        }
+        memcpy(facet->extra, record + 12 * sizeof(float), 2);
       }
-    } else
-      /* Read a single facet from an ASCII .STL file */
-    {
-      if((fscanf(stl->fp, "%*s %*s %f %f %f\n", &facet.normal.x, &facet.normal.y, &facet.normal.z) + \
-          fscanf(stl->fp, "%*s %*s") + \
-          fscanf(stl->fp, "%*s %f %f %f\n", &facet.vertex[0].x, &facet.vertex[0].y,  &facet.vertex[0].z) + \
-          fscanf(stl->fp, "%*s %f %f %f\n", &facet.vertex[1].x, &facet.vertex[1].y,  &facet.vertex[1].z) + \
-          fscanf(stl->fp, "%*s %f %f %f\n", &facet.vertex[2].x, &facet.vertex[2].y,  &facet.vertex[2].z) + \
-          fscanf(stl->fp, "%*s") + \
-          fscanf(stl->fp, "%*s")) != 12) {
-        perror("Something is syntactically very wrong with this ASCII STL!");
-        stl->error = 1;
-        return;
+    }
+
+    if(first) {
+      stl_facet_stats(stl, stl->facet_start[i], first);
+      first = 0;
+    }
+    stl_facets_min_max(stl, i, i + count);
+  }
+
+  free(buffer);
+  return 1;
+}
+
+static char *
+stl_ascii_next_token(stl_ascii_reader *reader) {
+  /* Returns the next whitespace separated token, or NULL at the end of the
+     file.  Tokens longer than the token buffer are truncated. */
+  size_t length = 0;
+  int    in_token = 0;
+  char   c;
+
+  for(;;) {
+    if(reader->position == reader->length) {
+      reader->length = stl_read_input(reader->stl, reader->buffer,
+                                      STL_ASCII_BUFFER_SIZE);
+      reader->position = 0;
+      if(reader->length == 0) break;
+    }
+    c = reader->buffer[reader->position];
+    if(c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f') {
+      if(in_token) break;
+      reader->position++;
+      continue;
+    }
+    in_token = 1;
+    if(length < STL_ASCII_TOKEN_SIZE - 1) {
+      reader->token[length++] = c;
+    }
+    reader->position++;
+  }
+
+  if(!in_token) return NULL;
+  reader->token[length] = '\0';
+  return reader->token;
+}
+
+static int
+stl_ascii_skip_tokens(stl_ascii_reader *reader, int count) {
+  int i;
+  for(i = 0; i < count; i++) {
+    if(stl_ascii_next_token(reader) == NULL) return 0;
+  }
+  return 1;
+}
+
+static int
+stl_ascii_read_floats(stl_ascii_reader *reader, float *values) {
+  char *token;
+  char *end;
+  int   i;
+
+  for(i = 0; i < 3; i++) {
+    token = stl_ascii_next_token(reader);
+    if(token == NULL) return 0;
+    values[i] = strtof(token, &end);
+    if(end == token) return 0;
+  }
+  return 1;
+}
+
+static int
+stl_read_ascii(stl_file *stl, int first_facet, int first) {
+  /* Every facet is "facet normal x y z", "outer loop", three times
+     "vertex x y z", "endloop" and "endfacet".  The keywords are skipped
+     without checking them, like the fscanf based reader did. */
+  stl_ascii_reader reader;
+  stl_facet facet;
+  char      c;
+  int       i, j;
+  int       result = 1;
+
+  facet.extra[0] = 0;
+  facet.extra[1] = 0;
+
+  stl_seek_input(stl, 0);
+  /* Skip the first line of the file */
+  while(stl_read_input(stl, &c, 1) == 1 && c != '\n');
+
+  reader.stl = stl;
+  reader.position = 0;
+  reader.length = 0;
+  reader.buffer = (char*)malloc(STL_ASCII_BUFFER_SIZE);
+  if(reader.buffer == NULL) return 0;
+
+  for(i = first_facet; i < stl->stats.number_of_facets; i++) {
+    if(!stl_ascii_skip_tokens(&reader, 2)
+        || !stl_ascii_read_floats(&reader, &facet.normal.x)
+        || !stl_ascii_skip_tokens(&reader, 2)) {
+      result = 0;
+      break;
+    }
+    for(j = 0; j < 3; j++) {
+      if(!stl_ascii_skip_tokens(&reader, 1)
+          || !stl_ascii_read_floats(&reader, &facet.vertex[j].x)) {
+        result = 0;
+        break;
       }
     }
+    if(!result || !stl_ascii_skip_tokens(&reader, 2)) {
+      result = 0;
+      break;
+    }
+
     /* Write the facet into memory. */
     stl->facet_start[i] = facet;
 
     stl_facet_stats(stl, facet, first);
     first = 0;
   }
-  stl->stats.size.x = stl->stats.max.x - stl->stats.min.x;
-  stl->stats.size.y = stl->stats.max.y - stl->stats.min.y;
-  stl->stats.size.z = stl->stats.max.z - stl->stats.min.z;
-  stl->stats.bounding_diameter = sqrt(
-                                   stl->stats.size.x * stl->stats.size.x +
-                                   stl->stats.size.y * stl->stats.size.y +
-                                   stl->stats.size.z * stl->stats.size.z
-                                 );
+
+  free(reader.buffer);
+  return result;
+}
+
+static void
+stl_facets_min_max(stl_file *stl, int first_facet, int last_facet) {
+  /* Updates the bounding box with the vertices of the given facets.  This
+     is the same fold as in stl_facet_stats, in the same order, but the
+     three coordinates are handled at once.  The SSE min and max return the
+     second operand for equal values and NaNs, just like STL_MIN and
+     STL_MAX, so the results are identical. */
+  int i, j;
+#ifdef STL_HAVE_SSE
+  float  result[4];
+  __m128 min = _mm_setr_ps(stl->stats.min.x, stl->stats.min.y, stl->stats.min.z, 0.0f);
+  __m128 max = _mm_setr_ps(stl->stats.max.x, stl->stats.max.y, stl->stats.max.z, 0.0f);
+
+  for(i = first_facet; i < last_facet; i++) {
+    for(j = 0; j < 3; j++) {
+      /* the fourth lane is the next coordinate or the extra bytes, it's never used */
+      __m128 vertex = _mm_loadu_ps(&stl->facet_start[i].vertex[j].x);
+      min = _mm_min_ps(min, vertex);
+      max = _mm_max_ps(max, vertex);
+    }
+  }
+
+  _mm_storeu_ps(result, min);
+  stl->stats.min.x = result[0];
+  stl->stats.min.y = result[1];
+  stl->stats.min.z = result[2];
+  _mm_storeu_ps(result, max);
+  stl->stats.max.x = result[0];
+  stl->stats.max.y = result[1];
+  stl->stats.max.z = result[2];
+#else
+  stl_vertex min = stl->stats.min;
+  stl_vertex max = stl->stats.max;
+
+  for(i = first_facet; i < last_facet; i++) {
+    for(j = 0; j < 3; j++) {
+      const stl_vertex *vertex = &stl->facet_start[i].vertex[j];
+      min.x = STL_MIN(min.x, vertex->x);
+      max.x = STL_MAX(max.x, vertex->x);
+      min.y = STL_MIN(min.y, vertex->y);
+      max.y = STL_MAX(max.y, vertex->y);
+      min.z = STL_MIN(min.z, vertex->z);
+      max.z = STL_MAX(max.z, vertex->z);
+    }
+  }
+
+  stl->stats.min = min;
+  stl->stats.max = max;
+#endif
 }
 
 void
@@ -20,20 +20,145 @@
  *           https://github.com/admesh/admesh/issues
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #include "stl.h"
 
 static void stl_rotate(float *x, float *y, float angle);
 static float get_area(stl_facet *facet);
 static float get_volume(stl_file *stl);
+static void stl_check_neighbors(stl_file *stl, int print_flag);
+static double stl_wall_time(void);
+
+
+void
+stl_set_threads(stl_file *stl, int threads, int deterministic) {
+  /* The stages that run on more threads give the same results as the
+     sequential code, except for the floating point sums, which are summed
+     per thread.  In deterministic mode those are summed in the original
+     order, so the output is the same byte for byte. */
+  stl->threads = STL_MAX(1, threads);
+  stl->deterministic = deterministic ? 1 : 0;
+}
+
+void
+stl_parallel_range(int count, int thread, int threads, int *begin, int *end) {
+  *begin = (int)((long long)count * thread / threads);
+  *end = (int)((long long)count * (thread + 1) / threads);
+}
+
+void
+stl_count_memory(stl_file *stl, long long bytes) {
+  /* Counts the bytes allocated, or freed if negative, for the peak in the
+     statistics.  Only the lists that grow with the number of facets are
+     counted, the rest is small. */
+  stl->stats.memory_allocated += bytes;
+  stl->stats.memory_peak = STL_MAX(stl->stats.memory_peak,
+                                   stl->stats.memory_allocated);
+}
+
+static double
+stl_wall_time(void) {
+  /* Seconds from some point in the past, for the timings in the statistics */
+#ifdef CLOCK_MONOTONIC
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+#else
+  /* without a monotonic clock the processor time has to do */
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+#ifdef HAVE_LIBPTHREAD
+typedef struct {
+  stl_file              *stl;
+  stl_parallel_function function;
+  void                  *data;
+  int                   thread;
+  int                   threads;
+} stl_parallel_task;
+
+static void *
+stl_parallel_thread(void *arg) {
+  stl_parallel_task *task = (stl_parallel_task*)arg;
+  task->function(task->stl, task->data, task->thread, task->threads);
+  return NULL;
+}
+#endif
+
+void
+stl_parallel_run(stl_file *stl, stl_parallel_function function, void *data) {
+  /* Runs the function on stl->threads threads, the calling thread is the
+     first one.  If a thread can't be started, or there are no threads at
+     all, its part runs on the calling thread. */
+  int threads = STL_MAX(1, stl->threads);
+  int i;
+#ifdef HAVE_LIBPTHREAD
+  pthread_t         *handles;
+  stl_parallel_task *tasks;
+  char              *started;
+
+  if(threads > 1) {
+    handles = (pthread_t*)malloc(threads * sizeof(pthread_t));
+    tasks = (stl_parallel_task*)malloc(threads * sizeof(stl_parallel_task));
+    started = (char*)calloc(threads, sizeof(char));
+    if(handles != NULL && tasks != NULL && started != NULL) {
+      for(i = 1; i < threads; i++) {
+        tasks[i].stl = stl;
+        tasks[i].function = function;
+        tasks[i].data = data;
+        tasks[i].thread = i;
+        tasks[i].threads = threads;
+        started[i] = (pthread_create(&handles[i], NULL,
+                                     stl_parallel_thread, &tasks[i]) == 0);
+      }
+      function(stl, data, 0, threads);
+      for(i = 1; i < threads; i++) {
+        if(started[i]) {
+          pthread_join(handles[i], NULL);
+        } else {
+          function(stl, data, i, threads);
+        }
+      }
+      free(handles);
+      free(tasks);
+      free(started);
+      return;
+    }
+    free(handles);
+    free(tasks);
+    free(started);
+  }
+#endif
+  for(i = 0; i < threads; i++) {
+    function(stl, data, i, threads);
+  }
+}
 
 
 void
 stl_verify_neighbors(stl_file *stl) {
+  stl_check_neighbors(stl, 1);
+}
+
+static void
+stl_check_neighbors(stl_file *stl, int print_flag) {
+  /* Counts the backwards edges, and prints the neighbors that don't match
+     if print_flag is set */
   int i;
   int j;
   stl_edge edge_a;
@@ -62,7 +187,7 @@ stl_verify_neighbors(stl_file *stl) {
         edge_b.p1 = stl->facet_start[neighbor].vertex[(vnot + 1) % 3];
         edge_b.p2 = stl->facet_start[neighbor].vertex[(vnot + 2) % 3];
       }
-      if(memcmp(&edge_a, &edge_b, SIZEOF_EDGE_SORT) != 0) {
+      if(print_flag && memcmp(&edge_a, &edge_b, SIZEOF_EDGE_SORT) != 0) {
         /* These edges should match but they don't.  Print results. */
         printf("edge %d of facet %d doesn't match edge %d of facet %d\n",
                j, i, vnot + 1, neighbor);
@@ -170,13 +295,17 @@ stl_scale(stl_file *stl, float factor) {
   stl_scale_versor(stl, versor);
 }
 
-static void calculate_normals(stl_file *stl) {
-  long i;
+static void
+calculate_normals_part(stl_file *stl, void *data, int thread, int threads) {
+  int i;
+  int begin;
+  int end;
   float normal[3];
 
-  if (stl->error) return;
-
-  for(i = 0; i < stl->stats.number_of_facets; i++) {
+  (void)data;
+  stl_parallel_range(stl->stats.number_of_facets, thread, threads,
+                     &begin, &end);
+  for(i = begin; i < end; i++) {
     stl_calculate_normal(normal, &stl->facet_start[i]);
     stl_normalize_vector(normal);
     stl->facet_start[i].normal.x = normal[0];
@@ -185,6 +314,12 @@ static void calculate_normals(stl_file *stl) {
   }
 }
 
+static void calculate_normals(stl_file *stl) {
+  if (stl->error) return;
+
+  stl_parallel_run(stl, calculate_normals_part, NULL);
+}
+
 void
 stl_rotate_x(stl_file *stl, float angle) {
   int i;
@@ -359,13 +494,55 @@ stl_mirror_xz(stl_file *stl) {
   stl->stats.facets_reversed -= stl->stats.number_of_facets;  /* for not altering stats */
 }
 
-static float get_volume(stl_file *stl) {
-  long i;
-  stl_vertex p0;
+static double
+get_volume_term(stl_facet *facet, stl_vertex p0) {
   stl_vertex p;
   stl_normal n;
   float height;
   float area;
+
+  p.x = facet->vertex[0].x - p0.x;
+  p.y = facet->vertex[0].y - p0.y;
+  p.z = facet->vertex[0].z - p0.z;
+  /* Do dot product to get distance from point to plane */
+  n = facet->normal;
+  height = (n.x * p.x) + (n.y * p.y) + (n.z * p.z);
+  area = get_area(facet);
+  return (area * height) / 3.0;
+}
+
+typedef struct {
+  stl_vertex p0;
+  double     *terms;     /* the term of every facet in deterministic mode */
+  float      *volumes;   /* the partial volume of every thread otherwise */
+} volume_data;
+
+static void
+get_volume_part(stl_file *stl, void *data, int thread, int threads) {
+  volume_data *volume = (volume_data*)data;
+  int i;
+  int begin;
+  int end;
+
+  stl_parallel_range(stl->stats.number_of_facets, thread, threads,
+                     &begin, &end);
+  if(volume->terms != NULL) {
+    for(i = begin; i < end; i++) {
+      volume->terms[i] = get_volume_term(&stl->facet_start[i], volume->p0);
+    }
+  } else {
+    volume->volumes[thread] = 0.0;
+    for(i = begin; i < end; i++) {
+      volume->volumes[thread] += get_volume_term(&stl->facet_start[i],
+                                                 volume->p0);
+    }
+  }
+}
+
+static float get_volume(stl_file *stl) {
+  long i;
+  stl_vertex p0;
+  volume_data data;
   float volume = 0.0;
 
   if (stl->error) return 0;
@@ -375,15 +552,43 @@ static float get_volume(stl_file *stl) {
   p0.y = stl->facet_start[0].vertex[0].y;
   p0.z = stl->facet_start[0].vertex[0].z;
 
+  if(stl->threads > 1) {
+    /* The terms are calculated in parallel.  In deterministic mode they are
+       summed in the same order as below, otherwise every thread sums its
+       own part. */
+    data.p0 = p0;
+    data.terms = NULL;
+    data.volumes = NULL;
+    if(stl->deterministic) {
+      data.terms = (double*)malloc(stl->stats.number_of_facets * sizeof(double));
+      if(data.terms != NULL) {
+        stl_count_memory(stl, (long long)stl->stats.number_of_facets *
+                         sizeof(double));
+      }
+    } else {
+      data.volumes = (float*)malloc(stl->threads * sizeof(float));
+    }
+    if(data.terms != NULL || data.volumes != NULL) {
+      stl_parallel_run(stl, get_volume_part, &data);
+      if(data.terms != NULL) {
+        for(i = 0; i < stl->stats.number_of_facets; i++) {
+          volume += data.terms[i];
+        }
+        free(data.terms);
+        stl_count_memory(stl, -(long long)stl->stats.number_of_facets *
+                         (long long)sizeof(double));
+      } else {
+        for(i = 0; i < stl->threads; i++) {
+          volume += data.volumes[i];
+        }
+        free(data.volumes);
+      }
+      return volume;
+    }
+  }
+
   for(i = 0; i < stl->stats.number_of_facets; i++) {
-    p.x = stl->facet_start[i].vertex[0].x - p0.x;
-    p.y = stl->facet_start[i].vertex[0].y - p0.y;
-    p.z = stl->facet_start[i].vertex[0].z - p0.z;
-    /* Do dot product to get distance from point to plane */
-    n = stl->facet_start[i].normal;
-    height = (n.x * p.x) + (n.y * p.y) + (n.z * p.z);
-    area = get_area(&stl->facet_start[i]);
-    volume += (area * height) / 3.0;
+    volume += get_volume_term(&stl->facet_start[i], p0);
   }
   return volume;
 }
@@ -393,6 +598,43 @@ void stl_calculate_volume(stl_file *stl) {
   stl->stats.volume = get_volume(stl);
 }
 
+void
+stl_calculate_part_stats(stl_file *stl, int *facets, int count,
+                         stl_part_stats *part) {
+  /* The statistics of the count facets listed in facets.  The volume is
+     summed like get_volume does, from the first vertex of the first facet,
+     so a mesh of one part has the same volume. */
+  stl_facet *facet;
+  stl_vertex p0;
+  float      volume = 0.0;
+  float      area = 0.0;
+  int        i;
+  int        j;
+
+  memset(part, 0, sizeof(*part));
+  if (stl->error || count == 0) return;
+
+  part->number_of_facets = count;
+  p0 = stl->facet_start[facets[0]].vertex[0];
+  part->min = p0;
+  part->max = p0;
+  for(i = 0; i < count; i++) {
+    facet = &stl->facet_start[facets[i]];
+    for(j = 0; j < 3; j++) {
+      part->min.x = STL_MIN(part->min.x, facet->vertex[j].x);
+      part->min.y = STL_MIN(part->min.y, facet->vertex[j].y);
+      part->min.z = STL_MIN(part->min.z, facet->vertex[j].z);
+      part->max.x = STL_MAX(part->max.x, facet->vertex[j].x);
+      part->max.y = STL_MAX(part->max.y, facet->vertex[j].y);
+      part->max.z = STL_MAX(part->max.z, facet->vertex[j].z);
+    }
+    volume += get_volume_term(facet, p0);
+    area += get_area(facet);
+  }
+  part->volume = volume;
+  part->area = area;
+}
+
 static float get_area(stl_facet *facet) {
   double cross[3][3];
   float sum[3];
@@ -439,18 +681,21 @@ void stl_repair(stl_file *stl,
                 int normal_values_flag,
                 int reverse_all_flag,
                 int verbose_flag) {
-  
-  int i;
-  int last_edges_fixed = 0;
+  double repair_start;
+  double start;
 
   if (stl->error) return;
 
+  /* Every stage is timed for the statistics */
+  repair_start = stl_wall_time();
   if(exact_flag || fixall_flag || nearby_flag || remove_unconnected_flag
       || fill_holes_flag || normal_directions_flag) {
     if (verbose_flag)
       printf("Checking exact...\n");
     exact_flag = 1;
+    start = stl_wall_time();
     stl_check_facets_exact(stl);
+    stl->stats.time_exact = stl_wall_time() - start;
     stl->stats.facets_w_1_bad_edge =
       (stl->stats.connected_facets_2_edge -
        stl->stats.connected_facets_3_edge);
@@ -471,26 +716,10 @@ void stl_repair(stl_file *stl,
     }
 
     if(stl->stats.connected_facets_3_edge < stl->stats.number_of_facets) {
-      for(i = 0; i < iterations; i++) {
-        if(stl->stats.connected_facets_3_edge <
-            stl->stats.number_of_facets) {
-          if (verbose_flag)
-            printf("\
-Checking nearby. Tolerance= %f Iteration=%d of %d...",
-                 tolerance, i + 1, iterations);
-          stl_check_facets_nearby(stl, tolerance);
-          if (verbose_flag)
-            printf("  Fixed %d edges.\n",
-                 stl->stats.edges_fixed - last_edges_fixed);
-          last_edges_fixed = stl->stats.edges_fixed;
-          tolerance += increment;
-        } else {
-          if (verbose_flag)
-            printf("\
-All facets connected.  No further nearby check necessary.\n");
-          break;
-        }
-      }
+      start = stl_wall_time();
+      stl_check_facets_nearby_iterations(stl, tolerance, increment,
+                                         iterations, verbose_flag);
+      stl->stats.time_nearby = stl_wall_time() - start;
     } else {
       if (verbose_flag)
         printf("All facets connected.  No nearby check necessary.\n");
@@ -501,7 +730,9 @@ All facets connected.  No further nearby check necessary.\n");
     if(stl->stats.connected_facets_3_edge <  stl->stats.number_of_facets) {
       if (verbose_flag)
         printf("Removing unconnected facets...\n");
+      start = stl_wall_time();
       stl_remove_unconnected_facets(stl);
+      stl->stats.time_remove_unconnected = stl_wall_time() - start;
     } else
       if (verbose_flag)
         printf("No unconnected need to be removed.\n");
@@ -511,7 +742,9 @@ All facets connected.  No further nearby check necessary.\n");
     if(stl->stats.connected_facets_3_edge <  stl->stats.number_of_facets) {
       if (verbose_flag)
         printf("Filling holes...\n");
+      start = stl_wall_time();
       stl_fill_holes(stl);
+      stl->stats.time_fill_holes = stl_wall_time() - start;
     } else
       if (verbose_flag)
         printf("No holes need to be filled.\n");
@@ -520,31 +753,41 @@ All facets connected.  No further nearby check necessary.\n");
   if(reverse_all_flag) {
     if (verbose_flag)
       printf("Reversing all facets...\n");
+    start = stl_wall_time();
     stl_reverse_all_facets(stl);
+    stl->stats.time_reverse_all = stl_wall_time() - start;
   }
 
   if(normal_directions_flag || fixall_flag) {
     if (verbose_flag)
       printf("Checking normal directions...\n");
+    start = stl_wall_time();
     stl_fix_normal_directions(stl);
+    stl->stats.time_normal_directions = stl_wall_time() - start;
   }
 
   if(normal_values_flag || fixall_flag) {
     if (verbose_flag)
       printf("Checking normal values...\n");
+    start = stl_wall_time();
     stl_fix_normal_values(stl);
+    stl->stats.time_normal_values = stl_wall_time() - start;
   }
 
   /* Always calculate the volume.  It shouldn't take too long */
   if (verbose_flag)
     printf("Calculating volume...\n");
+  start = stl_wall_time();
   stl_calculate_volume(stl);
+  stl->stats.time_volume = stl_wall_time() - start;
 
   if(fixall_flag) {
     if(stl->stats.volume < 0.0) {
       if (verbose_flag)
         printf("Reversing all facets because volume is negative...\n");
+      start = stl_wall_time();
       stl_reverse_all_facets(stl);
+      stl->stats.time_reverse_all += stl_wall_time() - start;
       stl->stats.volume = -stl->stats.volume;
     }
   }
@@ -552,6 +795,9 @@ All facets connected.  No further nearby check necessary.\n");
   if(exact_flag) {
     if (verbose_flag)
       printf("Verifying neighbors...\n");
-    stl_verify_neighbors(stl);
+    start = stl_wall_time();
+    stl_check_neighbors(stl, verbose_flag);
+    stl->stats.time_verify_neighbors = stl_wall_time() - start;
   }
+  stl->stats.time_repair = stl_wall_time() - repair_start;
 }
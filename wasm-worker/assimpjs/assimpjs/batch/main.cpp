@@ -0,0 +1,282 @@
+#include "assimpjs.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <map>
+#include <algorithm>
+#include <cctype>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static const char* CompanionExtensions[] = {
+	".png", ".jpg", ".jpeg", ".bmp", ".tga", ".gif", ".dds", ".txt", ".md", ".mtl", ".material", ".bin"
+};
+
+class ConversionJob
+{
+public:
+	std::string					formatName;
+	fs::path					mainFile;
+	std::vector<fs::path>		companionFiles;
+};
+
+class ConversionResult
+{
+public:
+	bool						success = false;
+	std::string					errorCode;
+	size_t						inputSize = 0;
+	size_t						outputSize = 0;
+	double						milliseconds = 0.0;
+};
+
+class FormatStatistics
+{
+public:
+	size_t						fileCount = 0;
+	size_t						failedCount = 0;
+	size_t						inputSize = 0;
+	size_t						outputSize = 0;
+	double						milliseconds = 0.0;
+};
+
+static std::string ToLowercase (const std::string& str)
+{
+	std::string res = str;
+	for (char& c : res) {
+		c = (char) std::tolower ((unsigned char) c);
+	}
+	return res;
+}
+
+static bool IsCompanionFile (const fs::path& path)
+{
+	std::string extension = ToLowercase (path.extension ().string ());
+	for (const char* companionExtension : CompanionExtensions) {
+		if (extension == companionExtension) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool ReadFileContent (const fs::path& path, Buffer& content)
+{
+	std::ifstream stream (path, std::ios::binary | std::ios::ate);
+	if (!stream.is_open ()) {
+		return false;
+	}
+	std::streamsize size = stream.tellg ();
+	stream.seekg (0, std::ios::beg);
+	content.resize ((size_t) size);
+	if (size > 0 && !stream.read ((char*) content.data (), size)) {
+		return false;
+	}
+	return true;
+}
+
+static std::vector<ConversionJob> CollectJobs (const fs::path& formatsFolder)
+{
+	std::vector<ConversionJob> jobs;
+	std::vector<fs::path> formatFolders;
+	for (const fs::directory_entry& entry : fs::directory_iterator (formatsFolder)) {
+		if (entry.is_directory () && fs::is_directory (entry.path () / "models")) {
+			formatFolders.push_back (entry.path ());
+		}
+	}
+	std::sort (formatFolders.begin (), formatFolders.end ());
+
+	for (const fs::path& formatFolder : formatFolders) {
+		std::vector<fs::path> mainFiles;
+		std::vector<fs::path> companionFiles;
+		for (const fs::directory_entry& entry : fs::directory_iterator (formatFolder / "models")) {
+			if (!entry.is_regular_file ()) {
+				continue;
+			}
+			if (IsCompanionFile (entry.path ())) {
+				companionFiles.push_back (entry.path ());
+			} else {
+				mainFiles.push_back (entry.path ());
+			}
+		}
+		std::sort (mainFiles.begin (), mainFiles.end ());
+		for (const fs::path& mainFile : mainFiles) {
+			jobs.push_back ({ formatFolder.filename ().string (), mainFile, companionFiles });
+		}
+	}
+	return jobs;
+}
+
+static ConversionResult RunJob (const ConversionJob& job, const std::string& format)
+{
+	ConversionResult result;
+
+	// the main file comes first, the companion files are there for the
+	// materials, textures and buffers the main file refers to
+	FileList fileList;
+	std::vector<fs::path> filePaths = { job.mainFile };
+	filePaths.insert (filePaths.end (), job.companionFiles.begin (), job.companionFiles.end ());
+	for (const fs::path& filePath : filePaths) {
+		Buffer content;
+		if (!ReadFileContent (filePath, content)) {
+			continue;
+		}
+		if (filePath == job.mainFile) {
+			result.inputSize = content.size ();
+		}
+		fileList.AddFile (filePath.string (), std::move (content));
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+	Result conversionResult = ConvertFileList (fileList, format);
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now () - start;
+
+	result.success = conversionResult.IsSuccess ();
+	result.errorCode = conversionResult.GetErrorCode ();
+	result.milliseconds = elapsed.count ();
+	for (size_t fileIndex = 0; fileIndex < conversionResult.FileCount (); fileIndex++) {
+		result.outputSize += conversionResult.GetFile (fileIndex).GetContent ().size ();
+	}
+	return result;
+}
+
+static size_t GetPeakMemoryUsage ()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo (GetCurrentProcess (), &counters, sizeof (counters))) {
+		return 0;
+	}
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage (RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+#ifdef __APPLE__
+	return (size_t) usage.ru_maxrss;
+#else
+	return (size_t) usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+static double ToMegabytes (size_t bytes)
+{
+	return (double) bytes / (1024.0 * 1024.0);
+}
+
+int main (int argc, const char* argv[])
+{
+	if (argc < 2) {
+		std::cout << "usage: AssimpJSBatch <formats folder> [thread count] [format]" << std::endl;
+		return 1;
+	}
+
+	fs::path formatsFolder = argv[1];
+	unsigned int threadCount = std::max (1u, std::thread::hardware_concurrency ());
+	if (argc >= 3) {
+		threadCount = std::max (1, std::atoi (argv[2]));
+	}
+	std::string format = "glb2";
+	if (argc >= 4) {
+		format = argv[3];
+	}
+
+	if (!fs::is_directory (formatsFolder)) {
+		std::cout << "folder not found: " << formatsFolder.string () << std::endl;
+		return 1;
+	}
+
+	std::vector<ConversionJob> jobs = CollectJobs (formatsFolder);
+	std::vector<ConversionResult> results (jobs.size ());
+
+	// every worker converts one file at a time, and every conversion creates
+	// its own Assimp::Importer, so the workers share nothing but the job index
+	std::atomic<size_t> nextJobIndex (0);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+	std::vector<std::thread> workers;
+	for (unsigned int threadIndex = 0; threadIndex < threadCount; threadIndex++) {
+		workers.push_back (std::thread ([&] () {
+			while (true) {
+				size_t jobIndex = nextJobIndex++;
+				if (jobIndex >= jobs.size ()) {
+					break;
+				}
+				results[jobIndex] = RunJob (jobs[jobIndex], format);
+			}
+		}));
+	}
+	for (std::thread& worker : workers) {
+		worker.join ();
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now () - start;
+
+	std::map<std::string, FormatStatistics> formatStatistics;
+	FormatStatistics totalStatistics;
+	for (size_t jobIndex = 0; jobIndex < jobs.size (); jobIndex++) {
+		const ConversionResult& result = results[jobIndex];
+		for (FormatStatistics* statistics : { &formatStatistics[jobs[jobIndex].formatName], &totalStatistics }) {
+			statistics->fileCount += 1;
+			statistics->failedCount += result.success ? 0 : 1;
+			statistics->inputSize += result.inputSize;
+			statistics->outputSize += result.outputSize;
+			statistics->milliseconds += result.milliseconds;
+		}
+	}
+
+	std::cout << std::fixed << std::setprecision (2);
+	std::cout << std::left << std::setw (12) << "format" << std::right
+		<< std::setw (8) << "files"
+		<< std::setw (8) << "failed"
+		<< std::setw (12) << "input MB"
+		<< std::setw (12) << "output MB"
+		<< std::setw (12) << "time ms"
+		<< std::setw (12) << "MB/s" << std::endl;
+	auto writeStatistics = [] (const std::string& name, const FormatStatistics& statistics) {
+		double seconds = statistics.milliseconds / 1000.0;
+		double throughput = seconds > 0.0 ? ToMegabytes (statistics.inputSize) / seconds : 0.0;
+		std::cout << std::left << std::setw (12) << name << std::right
+			<< std::setw (8) << statistics.fileCount
+			<< std::setw (8) << statistics.failedCount
+			<< std::setw (12) << ToMegabytes (statistics.inputSize)
+			<< std::setw (12) << ToMegabytes (statistics.outputSize)
+			<< std::setw (12) << statistics.milliseconds
+			<< std::setw (12) << throughput << std::endl;
+	};
+	for (const auto& it : formatStatistics) {
+		writeStatistics (it.first, it.second);
+	}
+	writeStatistics ("total", totalStatistics);
+
+	if (totalStatistics.failedCount > 0) {
+		std::cout << std::endl << "failures:" << std::endl;
+		for (size_t jobIndex = 0; jobIndex < jobs.size (); jobIndex++) {
+			const ConversionResult& result = results[jobIndex];
+			if (!result.success) {
+				std::cout << std::left << std::setw (12) << jobs[jobIndex].formatName
+					<< std::setw (48) << jobs[jobIndex].mainFile.filename ().string ()
+					<< result.errorCode << std::endl;
+			}
+		}
+	}
+
+	std::cout << std::endl;
+	std::cout << "threads: " << threadCount << std::endl;
+	std::cout << "wall time: " << elapsed.count () << " ms" << std::endl;
+	std::cout << "peak memory: " << ToMegabytes (GetPeakMemoryUsage ()) << " MB" << std::endl;
+	return 0;
+}
@@ -13,7 +13,7 @@ static File GetFile (const std::string& filePath)
 	size_t fileSize = stream->FileSize ();
 	Buffer content (fileSize);
 	stream->Read (&content[0], 1, fileSize);
-	return File (filePath, content);
+	return File (filePath, std::move (content));
 }
 
 int main (int argc, const char* argv[])
@@ -1,4 +1,8 @@
 #include "assimpjs.hpp"
+#include "mainfile.hpp"
+#include "quantizedglb.hpp"
+#include "references.hpp"
+#include "statistics.hpp"
 
 #include <assimp/Importer.hpp>
 #include <assimp/Exporter.hpp>
@@ -7,15 +11,78 @@
 
 #include <stdio.h>
 #include <iostream>
+#include <chrono>
+
+class PostProcessStep
+{
+public:
+	unsigned int	flag;
+	const char*		name;
+};
+
+// the steps are applied one by one in the same order as assimp applies them
+static const PostProcessStep PostProcessSteps[] = {
+	{ aiProcess_FindInstances, "find_instances" },
+	{ aiProcess_OptimizeGraph, "optimize_graph" },
+	{ aiProcess_GenUVCoords, "gen_uv_coords" },
+	{ aiProcess_Triangulate, "triangulate" },
+	{ aiProcess_SortByPType, "sort_by_ptype" },
+	{ aiProcess_OptimizeMeshes, "optimize_meshes" },
+	{ aiProcess_JoinIdenticalVertices, "join_identical_vertices" },
+	{ aiProcess_ImproveCacheLocality, "improve_cache_locality" }
+};
+
+class Timer
+{
+public:
+	Timer () :
+		start (std::chrono::steady_clock::now ())
+	{
+	}
+
+	double GetMilliseconds () const
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now () - start;
+		return elapsed.count ();
+	}
+
+private:
+	std::chrono::steady_clock::time_point start;
+};
+
+static bool IsQuantizedFormat (const std::string& format)
+{
+	return format == "glb2_quantized";
+}
+
+static unsigned int GetPostProcessFlags (PostProcessProfile profile, const std::string& format)
+{
+	unsigned int flags = aiProcess_Triangulate | aiProcess_GenUVCoords | aiProcess_SortByPType;
+	switch (profile) {
+		case PostProcessProfile::Default:
+			flags |= aiProcess_JoinIdenticalVertices;
+			break;
+		case PostProcessProfile::FastPreview:
+			break;
+		case PostProcessProfile::WebOptimized:
+			flags |= aiProcess_JoinIdenticalVertices;
+			flags |= aiProcess_OptimizeMeshes;
+			flags |= aiProcess_OptimizeGraph;
+			flags |= aiProcess_ImproveCacheLocality;
+			flags |= aiProcess_FindInstances;
+			break;
+	}
+	if (IsQuantizedFormat (format)) {
+		// the quantized writer keeps the triangle order, and reorders the vertices by it
+		flags |= aiProcess_ImproveCacheLocality;
+	}
+	return flags;
+}
 
 static const aiScene* ImportFileListByMainFile (Assimp::Importer& importer, const File& file)
 {
 	try {
-		const aiScene* scene = importer.ReadFile (file.path,
-			aiProcess_Triangulate |
-			aiProcess_GenUVCoords |
-			aiProcess_JoinIdenticalVertices |
-			aiProcess_SortByPType);
+		const aiScene* scene = importer.ReadFile (file.path, 0u);
 		return scene;
 	} catch (...) {
 		return nullptr;
@@ -23,6 +90,42 @@ static const aiScene* ImportFileListByMainFile (Assimp::Importer& importer, cons
 	return nullptr;
 }
 
+static const aiScene* ImportFileList (Assimp::Importer& importer, const FileList& fileList)
+{
+	std::vector<size_t> candidateIndices = GetMainFileCandidates (fileList, importer);
+	for (size_t fileIndex : candidateIndices) {
+		const File& file = fileList.GetFile (fileIndex);
+		const aiScene* scene = ImportFileListByMainFile (importer, file);
+		if (scene != nullptr) {
+			return scene;
+		}
+	}
+	return nullptr;
+}
+
+static const aiScene* PostProcessScene (Assimp::Importer& importer, const aiScene* scene, unsigned int flags, Result& result)
+{
+	if (scene == nullptr) {
+		return nullptr;
+	}
+	for (const PostProcessStep& step : PostProcessSteps) {
+		if ((flags & step.flag) == 0) {
+			continue;
+		}
+		Timer timer;
+		try {
+			scene = importer.ApplyPostProcessing (step.flag);
+		} catch (...) {
+			scene = nullptr;
+		}
+		result.AddStepTime (step.name, timer.GetMilliseconds ());
+		if (scene == nullptr) {
+			return nullptr;
+		}
+	}
+	return scene;
+}
+
 static std::string GetFileNameFromFormat (const std::string& format)
 {
 	std::string fileName = "result";
@@ -30,26 +133,70 @@ static std::string GetFileNameFromFormat (const std::string& format)
 		fileName += ".json";
 	} else if (format == "gltf" || format == "gltf2") {
 		fileName += ".gltf";
-	} else if (format == "glb" || format == "glb2") {
+	} else if (format == "glb" || format == "glb2" || IsQuantizedFormat (format)) {
 		fileName += ".glb";
 	}
 	return fileName;
 }
 
-static bool ExportScene (const aiScene* scene, const std::string& format, Result& result)
+static size_t EstimateGeometrySize (const aiScene* scene)
+{
+	size_t geometrySize = 0;
+	for (unsigned int meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++) {
+		const aiMesh* mesh = scene->mMeshes[meshIndex];
+		size_t vertexSize = sizeof (aiVector3D);
+		if (mesh->HasNormals ()) {
+			vertexSize += sizeof (aiVector3D);
+		}
+		for (unsigned int uvIndex = 0; uvIndex < AI_MAX_NUMBER_OF_TEXTURECOORDS; uvIndex++) {
+			if (mesh->HasTextureCoords (uvIndex)) {
+				vertexSize += mesh->mNumUVComponents[uvIndex] * sizeof (ai_real);
+			}
+		}
+		geometrySize += mesh->mNumVertices * vertexSize;
+		geometrySize += mesh->mNumFaces * 3 * sizeof (std::uint32_t);
+	}
+	return geometrySize;
+}
+
+static std::string GetGeometryFileName (const std::string& format, const std::string& fileName)
+{
+	if (format == "gltf" || format == "gltf2") {
+		return fileName.substr (0, fileName.find_last_of ('.')) + ".bin";
+	}
+	return fileName;
+}
+
+static bool ExportScene (Assimp::Importer& importer, const aiScene* scene, const std::string& format, Result& result)
 {
 	if (scene == nullptr) {
 		result.errorCode = ErrorCode::ImportError;
 		return false;
 	}
 
+	std::string fileName = GetFileNameFromFormat (format);
+	if (IsQuantizedFormat (format)) {
+		// assimp doesn't support quantized gltf, so it has its own writer, and the
+		// textures are read through the io system of the import
+		Buffer content;
+		if (!WriteQuantizedGlb (scene, importer.GetIOHandler (), content)) {
+			result.errorCode = ErrorCode::ExportError;
+			return false;
+		}
+		result.fileList.AddFile (fileName, std::move (content));
+		result.errorCode = ErrorCode::NoError;
+		return true;
+	}
+
+	// the raw geometry size is a lower bound for the file that contains the
+	// geometry, so reserving it up front saves most of the buffer growth
 	Assimp::Exporter exporter;
 	FileListIOSystemWriteAdapter* exportIOSystem = new FileListIOSystemWriteAdapter (result.fileList);
+	exportIOSystem->SetSizeHint (GetGeometryFileName (format, fileName), EstimateGeometrySize (scene));
 	exporter.SetIOHandler (exportIOSystem);
 
 	Assimp::ExportProperties exportProperties;
 	exportProperties.SetPropertyBool ("JSON_SKIP_WHITESPACES", true);
-	std::string fileName = GetFileNameFromFormat (format);
 	aiReturn exportResult = exporter.Export (scene, format.c_str (), fileName.c_str (), 0u, &exportProperties);
 	if (exportResult != aiReturn_SUCCESS) {
 		result.errorCode = ErrorCode::ExportError;
@@ -60,42 +207,153 @@ static bool ExportScene (const aiScene* scene, const std::string& format, Result
 	return true;
 }
 
+static void ExportSceneWithTime (Assimp::Importer& importer, const aiScene* scene, const std::string& format, Result& result)
+{
+	Timer exportTimer;
+	ExportScene (importer, scene, format, result);
+	if (scene != nullptr) {
+		result.AddStepTime ("export", exportTimer.GetMilliseconds ());
+	}
+}
+
 Result ConvertFile (const File& file, const std::string& format, const FileLoader& loader)
 {
+	return ConvertFile (file, format, loader, PostProcessProfile::Default);
+}
+
+Result ConvertFile (const File& file, const std::string& format, const FileLoader& loader, PostProcessProfile profile)
+{
+	Result result;
+
 	Assimp::Importer importer;
 	importer.SetIOHandler (new DelayLoadedIOSystemReadAdapter (file, loader));
+
+	Timer importTimer;
 	const aiScene* scene = ImportFileListByMainFile (importer, file);
+	result.AddStepTime ("import", importTimer.GetMilliseconds ());
 
-	Result result;
-	ExportScene (scene, format, result);
+	scene = PostProcessScene (importer, scene, GetPostProcessFlags (profile, format), result);
+	ExportSceneWithTime (importer, scene, format, result);
 	return result;
 }
 
 Result ConvertFileList (const FileList& fileList, const std::string& format)
+{
+	return ConvertFileList (fileList, format, PostProcessProfile::Default);
+}
+
+Result ConvertFileList (const FileList& fileList, const std::string& format, PostProcessProfile profile)
 {
 	if (fileList.FileCount () == 0) {
 		return Result (ErrorCode::NoFilesFound);
 	}
 
+	Result result;
+
 	Assimp::Importer importer;
 	importer.SetIOHandler (new FileListIOSystemReadAdapter (fileList));
 
-	const aiScene* scene = nullptr;
-	for (size_t fileIndex = 0; fileIndex < fileList.FileCount (); fileIndex++) {
-		const File& file = fileList.GetFile (fileIndex);
-		scene = ImportFileListByMainFile (importer, file);
-		if (scene != nullptr) {
-			break;
-		}
-	}
+	Timer importTimer;
+	const aiScene* scene = ImportFileList (importer, fileList);
+	result.AddStepTime ("import", importTimer.GetMilliseconds ());
 
-	Result result;
-	ExportScene (scene, format, result);
+	scene = PostProcessScene (importer, scene, GetPostProcessFlags (profile, format), result);
+	ExportSceneWithTime (importer, scene, format, result);
 	return result;
 }
 
+SceneStatistics AnalyzeFile (const File& file, const FileLoader& loader)
+{
+	return AnalyzeFile (file, loader, GetDefaultStatisticsThreadCount ());
+}
+
+SceneStatistics AnalyzeFile (const File& file, const FileLoader& loader, unsigned int threadCount)
+{
+	Assimp::Importer importer;
+	importer.SetIOHandler (new DelayLoadedIOSystemReadAdapter (file, loader));
+
+	// no post-processing at all, the statistics handle polygons on their own
+	const aiScene* scene = ImportFileListByMainFile (importer, file);
+	return GetSceneStatistics (scene, threadCount);
+}
+
+SceneStatistics AnalyzeFileList (const FileList& fileList)
+{
+	return AnalyzeFileList (fileList, GetDefaultStatisticsThreadCount ());
+}
+
+SceneStatistics AnalyzeFileList (const FileList& fileList, unsigned int threadCount)
+{
+	if (fileList.FileCount () == 0) {
+		return SceneStatistics (ErrorCode::NoFilesFound);
+	}
+
+	Assimp::Importer importer;
+	importer.SetIOHandler (new FileListIOSystemReadAdapter (fileList));
+
+	const aiScene* scene = ImportFileList (importer, fileList);
+	return GetSceneStatistics (scene, threadCount);
+}
+
 #ifdef EMSCRIPTEN
 
+static PostProcessProfile GetPostProcessProfile (const std::string& profileName)
+{
+	if (profileName == "fast_preview") {
+		return PostProcessProfile::FastPreview;
+	} else if (profileName == "web_optimized") {
+		return PostProcessProfile::WebOptimized;
+	}
+	return PostProcessProfile::Default;
+}
+
+class FileLoaderEmscripten : public FileLoader
+{
+public:
+	FileLoaderEmscripten (const emscripten::val& existsFunc, const emscripten::val& loadFunc) :
+		existsFunc (existsFunc),
+		loadFunc (loadFunc)
+	{
+	}
+
+	virtual bool Exists (const char* pFile) const override
+	{
+		if (existsFunc.isUndefined () || existsFunc.isNull ()) {
+			return false;
+		}
+		std::string fileName = GetFileName (pFile);
+		emscripten::val exists = existsFunc (fileName);
+		return exists.as<bool> ();
+	}
+
+	virtual Buffer Load (const char* pFile) const override
+	{
+		if (loadFunc.isUndefined () || loadFunc.isNull ()) {
+			return {};
+		}
+		std::string fileName = GetFileName (pFile);
+		emscripten::val fileBuffer = loadFunc (fileName);
+		return BufferFromJSArray (fileBuffer);
+	}
+
+private:
+	const emscripten::val& existsFunc;
+	const emscripten::val& loadFunc;
+};
+
+Result ConvertFileWithProfileEmscripten (
+	const std::string& name,
+	const std::string& format,
+	const emscripten::val& content,
+	const emscripten::val& existsFunc,
+	const emscripten::val& loadFunc,
+	const std::string& profileName)
+{
+	File file (name, BufferFromJSArray (content));
+	FileLoaderEmscripten loader (existsFunc, loadFunc);
+	return ConvertFile (file, format, loader, GetPostProcessProfile (profileName));
+}
+
 Result ConvertFileEmscripten (
 	const std::string& name,
 	const std::string& format,
@@ -103,44 +361,67 @@ Result ConvertFileEmscripten (
 	const emscripten::val& existsFunc,
 	const emscripten::val& loadFunc)
 {
-	class FileLoaderEmscripten : public FileLoader
-	{
-	public:
-		FileLoaderEmscripten (const emscripten::val& existsFunc, const emscripten::val& loadFunc) :
-			existsFunc (existsFunc),
-			loadFunc (loadFunc)
-		{
-		}
+	return ConvertFileWithProfileEmscripten (name, format, content, existsFunc, loadFunc, "default");
+}
 
-		virtual bool Exists (const char* pFile) const override
-		{
-			if (existsFunc.isUndefined () || existsFunc.isNull ()) {
-				return false;
-			}
-			std::string fileName = GetFileName (pFile);
-			emscripten::val exists = existsFunc (fileName);
-			return exists.as<bool> ();
-		}
+Result ConvertFileListWithProfileEmscripten (const FileList& fileList, const std::string& format, const std::string& profileName)
+{
+	return ConvertFileList (fileList, format, GetPostProcessProfile (profileName));
+}
 
-		virtual Buffer Load (const char* pFile) const override
-		{
-			if (loadFunc.isUndefined () || loadFunc.isNull ()) {
-				return {};
-			}
-			std::string fileName = GetFileName (pFile);
-			emscripten::val fileBuffer = loadFunc (fileName);
-			return emscripten::vecFromJSArray<std::uint8_t> (fileBuffer);
+static emscripten::val SceneStatisticsToJSObject (const SceneStatistics& statistics)
+{
+	emscripten::val result (emscripten::val::object ());
+	result.set ("success", statistics.IsSuccess ());
+	result.set ("errorCode", (int) statistics.errorCode);
+	result.set ("meshCount", statistics.meshCount);
+	result.set ("meshInstanceCount", statistics.meshInstanceCount);
+	result.set ("materialCount", statistics.materialCount);
+	result.set ("vertexCount", statistics.vertexCount);
+	result.set ("triangleCount", statistics.triangleCount);
+	result.set ("surfaceArea", statistics.surfaceArea);
+	if (statistics.HasBoundingBox ()) {
+		emscripten::val boundingBox (emscripten::val::object ());
+		emscripten::val minArr (emscripten::val::array ());
+		emscripten::val maxArr (emscripten::val::array ());
+		for (int i = 0; i < 3; i++) {
+			minArr.set (i, statistics.boundingBoxMin[i]);
+			maxArr.set (i, statistics.boundingBoxMax[i]);
 		}
+		boundingBox.set ("min", minArr);
+		boundingBox.set ("max", maxArr);
+		result.set ("boundingBox", boundingBox);
+	} else {
+		result.set ("boundingBox", emscripten::val::null ());
+	}
+	return result;
+}
 
-	private:
-		const emscripten::val& existsFunc;
-		const emscripten::val& loadFunc;
-	};
-
-	Buffer buffer = emscripten::vecFromJSArray<std::uint8_t> (content);
-	File file (name, buffer);
+emscripten::val AnalyzeFileEmscripten (
+	const std::string& name,
+	const emscripten::val& content,
+	const emscripten::val& existsFunc,
+	const emscripten::val& loadFunc)
+{
+	File file (name, BufferFromJSArray (content));
 	FileLoaderEmscripten loader (existsFunc, loadFunc);
-	return ConvertFile (file, format, loader);
+	return SceneStatisticsToJSObject (AnalyzeFile (file, loader));
+}
+
+emscripten::val AnalyzeFileListEmscripten (const FileList& fileList)
+{
+	return SceneStatisticsToJSObject (AnalyzeFileList (fileList));
+}
+
+emscripten::val GetReferencedFilesEmscripten (const std::string& name, const emscripten::val& content)
+{
+	File file (name, BufferFromJSArray (content));
+	std::vector<std::string> fileNames = GetReferencedFileNames (file);
+	emscripten::val fileNamesArr (emscripten::val::array ());
+	for (size_t i = 0; i < fileNames.size (); i++) {
+		fileNamesArr.set (i, fileNames[i]);
+	}
+	return fileNamesArr;
 }
 
 EMSCRIPTEN_BINDINGS (assimpjs)
@@ -162,10 +443,20 @@ EMSCRIPTEN_BINDINGS (assimpjs)
 		.function ("GetErrorCode", &Result::GetErrorCode)
 		.function ("FileCount", &Result::FileCount)
 		.function ("GetFile", &Result::GetFile)
+		.function ("GetFileSize", &Result::GetFileSize)
+		.function ("ReadFileChunk", &Result::ReadFileChunkEmscripten)
+		.function ("StepCount", &Result::StepCount)
+		.function ("GetStepName", &Result::GetStepName)
+		.function ("GetStepTime", &Result::GetStepTime)
 	;
 
 	emscripten::function<Result, const std::string&, const std::string&, const emscripten::val&, const emscripten::val&, const emscripten::val&> ("ConvertFile", &ConvertFileEmscripten);
+	emscripten::function<Result, const std::string&, const std::string&, const emscripten::val&, const emscripten::val&, const emscripten::val&, const std::string&> ("ConvertFile", &ConvertFileWithProfileEmscripten);
 	emscripten::function<Result, const FileList&, const std::string&> ("ConvertFileList", &ConvertFileList);
+	emscripten::function<emscripten::val, const std::string&, const emscripten::val&> ("GetReferencedFiles", &GetReferencedFilesEmscripten);
+	emscripten::function<Result, const FileList&, const std::string&, const std::string&> ("ConvertFileList", &ConvertFileListWithProfileEmscripten);
+	emscripten::function<emscripten::val, const std::string&, const emscripten::val&, const emscripten::val&, const emscripten::val&> ("AnalyzeFile", &AnalyzeFileEmscripten);
+	emscripten::function<emscripten::val, const FileList&> ("AnalyzeFileList", &AnalyzeFileListEmscripten);
 }
 
 #endif
@@ -8,11 +8,29 @@
 #include "filelist.hpp"
 #include "fileio.hpp"
 #include "result.hpp"
+#include "statistics.hpp"
 
 #include <vector>
 #include <string>
 
+enum class PostProcessProfile : int
+{
+	// triangulation and vertex joining, the same as before profiles existed
+	Default = 0,
+	// skips vertex joining, which is the slowest step on huge inputs
+	FastPreview = 1,
+	// merges meshes and instances, and optimizes for the vertex cache
+	WebOptimized = 2
+};
+
 Result ConvertFile (const File& file, const std::string& format, const FileLoader& loader);
+Result ConvertFile (const File& file, const std::string& format, const FileLoader& loader, PostProcessProfile profile);
 Result ConvertFileList (const FileList& fileList, const std::string& format);
+Result ConvertFileList (const FileList& fileList, const std::string& format, PostProcessProfile profile);
+
+SceneStatistics AnalyzeFile (const File& file, const FileLoader& loader);
+SceneStatistics AnalyzeFile (const File& file, const FileLoader& loader, unsigned int threadCount);
+SceneStatistics AnalyzeFileList (const FileList& fileList);
+SceneStatistics AnalyzeFileList (const FileList& fileList, unsigned int threadCount);
 
 #endif
@@ -26,15 +26,34 @@ static size_t ReadFromBuffer (const Buffer* buffer, size_t& position, void* pvBu
 static size_t WriteToBuffer (Buffer* buffer, size_t& position, const void* pvBuffer, size_t pSize, size_t pCount)
 {
 	size_t memSize = pSize * pCount;
-	size_t newBufferSize = std::max (buffer->size (), position + memSize);
-	if (newBufferSize > buffer->size ()) {
-		buffer->resize (newBufferSize);
+	size_t endPosition = position + memSize;
+	if (endPosition > buffer->capacity ()) {
+		// exporters write in many small pieces, so grow the capacity geometrically
+		buffer->reserve (std::max (endPosition, buffer->capacity () * 2));
 	}
-	memcpy (buffer->data () + position, pvBuffer, memSize);
-	position += memSize;
+	if (position > buffer->size ()) {
+		buffer->resize (position);
+	}
+
+	const std::uint8_t* bytes = (const std::uint8_t*) pvBuffer;
+	size_t overwriteSize = std::min (memSize, buffer->size () - position);
+	if (overwriteSize > 0) {
+		memcpy (buffer->data () + position, bytes, overwriteSize);
+	}
+	buffer->insert (buffer->end (), bytes + overwriteSize, bytes + memSize);
+	position = endPosition;
 	return pCount;
 }
 
+static void TrimBuffer (Buffer* buffer)
+{
+	// trimming means one more copy, so do it only if there is a lot of unused space
+	size_t unusedSize = buffer->capacity () - buffer->size ();
+	if (unusedSize > buffer->size () / 4) {
+		buffer->shrink_to_fit ();
+	}
+}
+
 static aiReturn SeekInBuffer (const Buffer* buffer, size_t& position, size_t pOffset, aiOrigin pOrigin)
 {
 	switch (pOrigin) {
@@ -63,7 +82,7 @@ FileLoader::~FileLoader ()
 
 }
 
-BufferIOStreamReadAdapter::BufferIOStreamReadAdapter (const Buffer* buffer) :
+BufferIOStreamReadAdapter::BufferIOStreamReadAdapter (const BufferPtr& buffer) :
 	buffer (buffer),
 	position (0)
 {
@@ -76,7 +95,7 @@ BufferIOStreamReadAdapter::~BufferIOStreamReadAdapter ()
 
 size_t BufferIOStreamReadAdapter::Read (void* pvBuffer, size_t pSize, size_t pCount)
 {
-	return ReadFromBuffer (buffer, position, pvBuffer, pSize, pCount);
+	return ReadFromBuffer (buffer.get (), position, pvBuffer, pSize, pCount);
 }
 
 size_t BufferIOStreamReadAdapter::Write (const void* pvBuffer, size_t pSize, size_t pCount)
@@ -86,7 +105,7 @@ size_t BufferIOStreamReadAdapter::Write (const void* pvBuffer, size_t pSize, siz
 
 aiReturn BufferIOStreamReadAdapter::Seek (size_t pOffset, aiOrigin pOrigin)
 {
-	return SeekInBuffer (buffer, position, pOffset, pOrigin);
+	return SeekInBuffer (buffer.get (), position, pOffset, pOrigin);
 }
 
 size_t BufferIOStreamReadAdapter::Tell () const
@@ -104,7 +123,7 @@ void BufferIOStreamReadAdapter::Flush ()
 
 }
 
-BufferIOStreamWriteAdapter::BufferIOStreamWriteAdapter (Buffer* buffer) :
+BufferIOStreamWriteAdapter::BufferIOStreamWriteAdapter (const std::shared_ptr<Buffer>& buffer) :
 	buffer (buffer),
 	position (0)
 {
@@ -112,22 +131,22 @@ BufferIOStreamWriteAdapter::BufferIOStreamWriteAdapter (Buffer* buffer) :
 
 BufferIOStreamWriteAdapter::~BufferIOStreamWriteAdapter ()
 {
-
+	TrimBuffer (buffer.get ());
 }
 
 size_t BufferIOStreamWriteAdapter::Read (void* pvBuffer, size_t pSize, size_t pCount)
 {
-	return ReadFromBuffer (buffer, position, pvBuffer, pSize, pCount);
+	return ReadFromBuffer (buffer.get (), position, pvBuffer, pSize, pCount);
 }
 
 size_t BufferIOStreamWriteAdapter::Write (const void* pvBuffer, size_t pSize, size_t pCount)
 {
-	return WriteToBuffer (buffer, position, pvBuffer, pSize, pCount);
+	return WriteToBuffer (buffer.get (), position, pvBuffer, pSize, pCount);
 }
 
 aiReturn BufferIOStreamWriteAdapter::Seek (size_t pOffset, aiOrigin pOrigin)
 {
-	return SeekInBuffer (buffer, position, pOffset, pOrigin);
+	return SeekInBuffer (buffer.get (), position, pOffset, pOrigin);
 }
 
 size_t BufferIOStreamWriteAdapter::Tell () const
@@ -145,19 +164,11 @@ void BufferIOStreamWriteAdapter::Flush ()
 
 }
 
-OwnerBufferIOStreamReadAdapter::OwnerBufferIOStreamReadAdapter (const Buffer* buffer) :
-	BufferIOStreamReadAdapter (buffer)
-{
-}
-
-OwnerBufferIOStreamReadAdapter::~OwnerBufferIOStreamReadAdapter ()
-{
-	delete buffer;
-}
-
 DelayLoadedIOSystemReadAdapter::DelayLoadedIOSystemReadAdapter (const File& file, const FileLoader& loader) :
 	file (file),
-	loader (loader)
+	loader (loader),
+	loadedFiles (),
+	existingFiles ()
 {
 }
 
@@ -168,23 +179,33 @@ DelayLoadedIOSystemReadAdapter::~DelayLoadedIOSystemReadAdapter ()
 
 bool DelayLoadedIOSystemReadAdapter::Exists (const char* pFile) const
 {
-	if (GetFileName (file.path) == GetFileName (pFile)) {
+	if (IsSameFileName (file.path.c_str (), pFile)) {
+		return true;
+	}
+	if (loadedFiles.FindFile (pFile) != nullptr) {
 		return true;
 	}
-	return loader.Exists (pFile);
+	return ExistsInLoader (pFile);
 }
 
 Assimp::IOStream* DelayLoadedIOSystemReadAdapter::Open (const char* pFile, const char* pMode)
 {
-	if (GetFileName (file.path) == GetFileName (pFile)) {
-		return new BufferIOStreamReadAdapter (&file.content);
+	if (IsSameFileName (file.path.c_str (), pFile)) {
+		return new BufferIOStreamReadAdapter (file.content);
+	}
+
+	// assimp may open the same file several times, but the loader is called
+	// only once for every file during the conversion
+	const File* loadedFile = loadedFiles.FindFile (pFile);
+	if (loadedFile != nullptr) {
+		return new BufferIOStreamReadAdapter (loadedFile->content);
 	}
-	if (!loader.Exists (pFile)) {
+	if (!ExistsInLoader (pFile)) {
 		return nullptr;
 	}
-	Buffer buffer = loader.Load (pFile);
-	Buffer* bufferPtr = new Buffer (buffer);
-	return new OwnerBufferIOStreamReadAdapter (bufferPtr);
+	BufferPtr buffer = std::make_shared<const Buffer> (loader.Load (pFile));
+	loadedFiles.AddFile (pFile, buffer);
+	return new BufferIOStreamReadAdapter (buffer);
 }
 
 void DelayLoadedIOSystemReadAdapter::Close (Assimp::IOStream* pFile)
@@ -197,6 +218,18 @@ char DelayLoadedIOSystemReadAdapter::getOsSeparator () const
 	return GetOsSeparator ();
 }
 
+bool DelayLoadedIOSystemReadAdapter::ExistsInLoader (const char* pFile) const
+{
+	std::string fileName = GetFileName (pFile);
+	auto found = existingFiles.find (fileName);
+	if (found != existingFiles.end ()) {
+		return found->second;
+	}
+	bool exists = loader.Exists (pFile);
+	existingFiles.insert ({ fileName, exists });
+	return exists;
+}
+
 FileListIOSystemReadAdapter::FileListIOSystemReadAdapter (const FileList& fileList) :
 	fileList (fileList)
 {
@@ -209,16 +242,16 @@ FileListIOSystemReadAdapter::~FileListIOSystemReadAdapter ()
 
 bool FileListIOSystemReadAdapter::Exists (const char* pFile) const
 {
-	return fileList.GetFile (pFile) != nullptr;
+	return fileList.FindFile (pFile) != nullptr;
 }
 
 Assimp::IOStream* FileListIOSystemReadAdapter::Open (const char* pFile, const char* pMode)
 {
-	const File* foundFile = fileList.GetFile (pFile);
+	const File* foundFile = fileList.FindFile (pFile);
 	if (foundFile == nullptr) {
 		return nullptr;
 	}
-	return new BufferIOStreamReadAdapter (&foundFile->content);
+	return new BufferIOStreamReadAdapter (foundFile->content);
 }
 
 void FileListIOSystemReadAdapter::Close (Assimp::IOStream* pFile)
@@ -232,7 +265,9 @@ char FileListIOSystemReadAdapter::getOsSeparator () const
 }
 
 FileListIOSystemWriteAdapter::FileListIOSystemWriteAdapter (FileList& fileList) :
-	fileList (fileList)
+	fileList (fileList),
+	sizeHintFileName (),
+	sizeHint (0)
 {
 }
 
@@ -241,25 +276,32 @@ FileListIOSystemWriteAdapter::~FileListIOSystemWriteAdapter ()
 
 }
 
+void FileListIOSystemWriteAdapter::SetSizeHint (const std::string& fileName, size_t size)
+{
+	sizeHintFileName = fileName;
+	sizeHint = size;
+}
+
 bool FileListIOSystemWriteAdapter::Exists (const char* pFile) const
 {
-	return fileList.GetFile (pFile) != nullptr;
+	return fileList.FindFile (pFile) != nullptr;
 }
 
 Assimp::IOStream* FileListIOSystemWriteAdapter::Open (const char* pFile, const char* pMode)
 {
-	File* foundFile = fileList.GetFile (pFile);
-	if (foundFile != nullptr) {
-		return new BufferIOStreamWriteAdapter (&foundFile->content);
+	// the stream writes directly into the buffer owned by the file list, so the
+	// exported content doesn't have to be copied after the export
+	std::shared_ptr<Buffer> buffer = std::make_shared<Buffer> ();
+	if (sizeHint > 0 && IsSameFileName (sizeHintFileName.c_str (), pFile)) {
+		buffer->reserve (sizeHint);
 	}
-
-	fileList.AddFile (pFile, {});
-	File* newFile = fileList.GetFile (pFile);
-	if (newFile != nullptr) {
-		return new BufferIOStreamWriteAdapter (&newFile->content);
+	File* foundFile = fileList.FindFile (pFile);
+	if (foundFile != nullptr) {
+		foundFile->content = buffer;
+	} else {
+		fileList.AddFile (pFile, buffer);
 	}
-
-	return nullptr;
+	return new BufferIOStreamWriteAdapter (buffer);
 }
 
 void FileListIOSystemWriteAdapter::Close (Assimp::IOStream* pFile)
@@ -6,6 +6,8 @@
 
 #include "filelist.hpp"
 
+#include <unordered_map>
+
 class FileLoader
 {
 public:
@@ -19,7 +21,7 @@ public:
 class BufferIOStreamReadAdapter : public Assimp::IOStream
 {
 public:
-	BufferIOStreamReadAdapter (const Buffer* buffer);
+	BufferIOStreamReadAdapter (const BufferPtr& buffer);
 	virtual ~BufferIOStreamReadAdapter ();
 
 	virtual size_t		Read (void* pvBuffer, size_t pSize, size_t pCount) override;
@@ -32,14 +34,14 @@ public:
 	virtual void		Flush () override;
 
 protected:
-	const Buffer*		buffer;
+	BufferPtr			buffer;
 	size_t				position;
 };
 
 class BufferIOStreamWriteAdapter : public Assimp::IOStream
 {
 public:
-	BufferIOStreamWriteAdapter (Buffer* buffer);
+	BufferIOStreamWriteAdapter (const std::shared_ptr<Buffer>& buffer);
 	virtual ~BufferIOStreamWriteAdapter ();
 
 	virtual size_t		Read (void* pvBuffer, size_t pSize, size_t pCount) override;
@@ -52,15 +54,8 @@ public:
 	virtual void		Flush () override;
 
 protected:
-	Buffer*				buffer;
-	size_t				position;
-};
-
-class OwnerBufferIOStreamReadAdapter : public BufferIOStreamReadAdapter
-{
-public:
-	OwnerBufferIOStreamReadAdapter (const Buffer* buffer);
-	virtual ~OwnerBufferIOStreamReadAdapter ();
+	std::shared_ptr<Buffer>	buffer;
+	size_t					position;
 };
 
 class DelayLoadedIOSystemReadAdapter : public Assimp::IOSystem
@@ -76,8 +71,12 @@ public:
 	virtual char				getOsSeparator () const override;
 
 private:
-	const File&					file;
-	const FileLoader&			loader;
+	bool						ExistsInLoader (const char* pFile) const;
+
+	const File&										file;
+	const FileLoader&								loader;
+	FileList										loadedFiles;
+	mutable std::unordered_map<std::string, bool>	existingFiles;
 };
 
 class FileListIOSystemReadAdapter : public Assimp::IOSystem
@@ -102,6 +101,8 @@ public:
 	FileListIOSystemWriteAdapter (FileList& fileList);
 	virtual ~FileListIOSystemWriteAdapter ();
 
+	void						SetSizeHint (const std::string& fileName, size_t size);
+
 	virtual bool				Exists (const char* pFile) const override;
 	virtual Assimp::IOStream*	Open (const char* pFile, const char* pMode) override;
 	virtual void				Close (Assimp::IOStream* pFile) override;
@@ -110,6 +111,8 @@ public:
 
 private:
 	FileList&					fileList;
+	std::string					sizeHintFileName;
+	size_t						sizeHint;
 };
 
 #endif
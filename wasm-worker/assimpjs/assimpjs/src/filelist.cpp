@@ -1,5 +1,8 @@
 #include "filelist.hpp"
 
+#include <cstring>
+#include <cctype>
+
 static std::string ToLowercase (const std::string& str)
 {
 	std::string res = str;
@@ -9,13 +12,58 @@ static std::string ToLowercase (const std::string& str)
 	return res;
 }
 
+static const char* GetFileNameStart (const char* path)
+{
+	const char* lastSeparator = std::strrchr (path, '/');
+	if (lastSeparator == nullptr) {
+		lastSeparator = std::strrchr (path, '\\');
+	}
+	if (lastSeparator == nullptr) {
+		return path;
+	}
+	return lastSeparator + 1;
+}
+
+static size_t GetFileNameHash (const char* fileName)
+{
+	// FNV-1a on the lowercase characters, so it matches the comparison in
+	// IsSameFileName without creating a lowercase copy of the name
+	std::uint32_t hash = 2166136261u;
+	for (const char* c = fileName; *c != '\0'; c++) {
+		hash ^= (std::uint32_t) std::tolower ((unsigned char) *c);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static bool IsSameFileNameLowercase (const char* fileName1, const char* fileName2)
+{
+	while (*fileName1 != '\0' && *fileName2 != '\0') {
+		if (std::tolower ((unsigned char) *fileName1) != std::tolower ((unsigned char) *fileName2)) {
+			return false;
+		}
+		fileName1++;
+		fileName2++;
+	}
+	return *fileName1 == *fileName2;
+}
+
 File::File () :
-	path (),
-	content ()
+	File (std::string (), Buffer ())
 {
 }
 
 File::File (const std::string& path, const Buffer& content) :
+	File (path, std::make_shared<const Buffer> (content))
+{
+}
+
+File::File (const std::string& path, Buffer&& content) :
+	File (path, std::make_shared<const Buffer> (std::move (content)))
+{
+}
+
+File::File (const std::string& path, const BufferPtr& content) :
 	path (path),
 	content (content)
 {
@@ -26,24 +74,43 @@ const std::string& File::GetPath () const
 	return path;
 }
 
+const Buffer& File::GetContent () const
+{
+	return *content;
+}
+
 #ifdef EMSCRIPTEN
 
 emscripten::val File::GetContentEmscripten () const
 {
 	emscripten::val Uint8Array = emscripten::val::global ("Uint8Array");
-	return Uint8Array.new_ (emscripten::typed_memory_view (content.size (), content.data ()));
+	return Uint8Array.new_ (emscripten::typed_memory_view (content->size (), content->data ()));
 }
 
 #endif
 
 FileList::FileList () :
-	files ()
+	files (),
+	fileIndices ()
 {
 }
 
 void FileList::AddFile (const std::string& path, const Buffer& content)
 {
 	files.push_back (File (path, content));
+	AddLastFileToIndex ();
+}
+
+void FileList::AddFile (const std::string& path, Buffer&& content)
+{
+	files.push_back (File (path, std::move (content)));
+	AddLastFileToIndex ();
+}
+
+void FileList::AddFile (const std::string& path, const BufferPtr& content)
+{
+	files.push_back (File (path, content));
+	AddLastFileToIndex ();
 }
 
 size_t FileList::FileCount () const
@@ -58,14 +125,7 @@ File& FileList::GetFile (size_t index)
 
 File* FileList::GetFile (const std::string& path)
 {
-	std::string fileName = GetFileName (path);
-	for (File& file : files) {
-		std::string currFileName = GetFileName (file.path);
-		if (currFileName == fileName) {
-			return &file;
-		}
-	}
-	return nullptr;
+	return FindFile (path.c_str ());
 }
 
 const File& FileList::GetFile (size_t index) const
@@ -78,12 +138,41 @@ const File* FileList::GetFile (const std::string& path) const
 	return const_cast<FileList*> (this)->GetFile (path);
 }
 
+File* FileList::FindFile (const char* path)
+{
+	const char* fileName = GetFileNameStart (path);
+	auto range = fileIndices.equal_range (GetFileNameHash (fileName));
+	for (auto it = range.first; it != range.second; ++it) {
+		File& file = files[it->second];
+		if (IsSameFileNameLowercase (GetFileNameStart (file.path.c_str ()), fileName)) {
+			return &file;
+		}
+	}
+	return nullptr;
+}
+
+const File* FileList::FindFile (const char* path) const
+{
+	return const_cast<FileList*> (this)->FindFile (path);
+}
+
+void FileList::AddLastFileToIndex ()
+{
+	// only the first file is indexed for every name, because lookup returns
+	// the first file with a matching name
+	size_t fileIndex = files.size () - 1;
+	const char* fileName = GetFileNameStart (files[fileIndex].path.c_str ());
+	if (FindFile (fileName) != nullptr) {
+		return;
+	}
+	fileIndices.insert ({ GetFileNameHash (fileName), fileIndex });
+}
+
 #ifdef EMSCRIPTEN
 
 void FileList::AddFileEmscripten (const std::string& path, const emscripten::val& content)
 {
-	Buffer contentArr = emscripten::vecFromJSArray<std::uint8_t> (content);
-	AddFile (path, contentArr);
+	AddFile (path, BufferFromJSArray (content));
 }
 
 #endif
@@ -100,3 +189,22 @@ std::string GetFileName (const std::string& path)
 	std::string fileName = path.substr (lastSeparator + 1, path.length () - lastSeparator - 1);
 	return ToLowercase (fileName);
 }
+
+bool IsSameFileName (const char* path1, const char* path2)
+{
+	return IsSameFileNameLowercase (GetFileNameStart (path1), GetFileNameStart (path2));
+}
+
+#ifdef EMSCRIPTEN
+
+Buffer BufferFromJSArray (const emscripten::val& content)
+{
+	// copy the typed array with a single set call into the wasm heap instead of
+	// converting it element by element like vecFromJSArray does
+	Buffer buffer (content["length"].as<size_t> ());
+	emscripten::val heapView (emscripten::typed_memory_view (buffer.size (), buffer.data ()));
+	heapView.call<void> ("set", content);
+	return buffer;
+}
+
+#endif
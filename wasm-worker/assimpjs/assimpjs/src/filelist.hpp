@@ -7,23 +7,30 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
 
 using Buffer = std::vector<std::uint8_t>;
+using BufferPtr = std::shared_ptr<const Buffer>;
 
 class File
 {
 public:
 	File ();
 	File (const std::string& path, const Buffer& content);
+	File (const std::string& path, Buffer&& content);
+	File (const std::string& path, const BufferPtr& content);
 
 	const std::string&	GetPath () const;
+	const Buffer&		GetContent () const;
 
 #ifdef EMSCRIPTEN
 	emscripten::val		GetContentEmscripten () const;
 #endif
 
 	std::string			path;
-	Buffer				content;
+	BufferPtr			content;
 };
 
 class FileList
@@ -32,6 +39,8 @@ public:
 	FileList ();
 
 	void			AddFile (const std::string& path, const Buffer& content);
+	void			AddFile (const std::string& path, Buffer&& content);
+	void			AddFile (const std::string& path, const BufferPtr& content);
 	
 	size_t			FileCount () const;
 	File&			GetFile (size_t index);
@@ -39,14 +48,25 @@ public:
 	const File&		GetFile (size_t index) const;
 	const File*		GetFile (const std::string& path) const;
 
+	File*			FindFile (const char* path);
+	const File*		FindFile (const char* path) const;
+
 #ifdef EMSCRIPTEN
 	void			AddFileEmscripten (const std::string& path, const emscripten::val& content);
 #endif
 
 private:
-	std::vector<File>	files;
+	void			AddLastFileToIndex ();
+
+	std::vector<File>							files;
+	std::unordered_multimap<size_t, size_t>		fileIndices;
 };
 
 std::string GetFileName (const std::string& path);
+bool IsSameFileName (const char* path1, const char* path2);
+
+#ifdef EMSCRIPTEN
+Buffer BufferFromJSArray (const emscripten::val& content);
+#endif
 
 #endif
@@ -0,0 +1,104 @@
+#include "mainfile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+
+enum class MainFileRank : int
+{
+	NotModel = 0,
+	Unknown = 1,
+	KnownContent = 2,
+	KnownExtension = 3
+};
+
+class MainFileCandidate
+{
+public:
+	size_t			fileIndex;
+	MainFileRank	rank;
+};
+
+static const char* CompanionExtensions[] = {
+	"png", "jpg", "jpeg", "bmp", "tga", "gif", "dds", "ktx", "ktx2", "webp", "tif", "tiff", "hdr", "exr", "psd",
+	"mtl", "material", "bin", "txt"
+};
+
+static const char* ModelSignatures[] = {
+	"glTF",
+	"Kaydara FBX Binary",
+	"ply\n",
+	"ply\r",
+	"solid",
+	"BLENDER",
+	"xof "
+};
+
+static std::string GetFileExtension (const std::string& path)
+{
+	std::string fileName = GetFileName (path);
+	size_t lastDot = fileName.find_last_of ('.');
+	if (lastDot == std::string::npos) {
+		return std::string ();
+	}
+	return fileName.substr (lastDot + 1);
+}
+
+static bool IsCompanionExtension (const std::string& extension)
+{
+	for (const char* companionExtension : CompanionExtensions) {
+		if (extension == companionExtension) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool HasModelSignature (const Buffer& content)
+{
+	for (const char* signature : ModelSignatures) {
+		size_t signatureLength = std::strlen (signature);
+		if (content.size () >= signatureLength && std::memcmp (content.data (), signature, signatureLength) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static MainFileRank GetMainFileRank (const File& file, const Assimp::Importer& importer)
+{
+	std::string extension = GetFileExtension (file.path);
+	if (IsCompanionExtension (extension)) {
+		return MainFileRank::NotModel;
+	}
+	if (!extension.empty () && importer.IsExtensionSupported (extension)) {
+		return MainFileRank::KnownExtension;
+	}
+	if (HasModelSignature (file.GetContent ())) {
+		return MainFileRank::KnownContent;
+	}
+	return MainFileRank::Unknown;
+}
+
+std::vector<size_t> GetMainFileCandidates (const FileList& fileList, const Assimp::Importer& importer)
+{
+	std::vector<MainFileCandidate> candidates;
+	for (size_t fileIndex = 0; fileIndex < fileList.FileCount (); fileIndex++) {
+		MainFileRank rank = GetMainFileRank (fileList.GetFile (fileIndex), importer);
+		if (rank == MainFileRank::NotModel) {
+			continue;
+		}
+		candidates.push_back ({ fileIndex, rank });
+	}
+
+	// stable sort keeps the original order for files with the same rank
+	std::stable_sort (candidates.begin (), candidates.end (), [] (const MainFileCandidate& a, const MainFileCandidate& b) {
+		return (int) a.rank > (int) b.rank;
+	});
+
+	std::vector<size_t> fileIndices;
+	for (const MainFileCandidate& candidate : candidates) {
+		fileIndices.push_back (candidate.fileIndex);
+	}
+	return fileIndices;
+}
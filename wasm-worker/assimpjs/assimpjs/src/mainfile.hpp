@@ -0,0 +1,15 @@
+#ifndef MAINFILE_HPP
+#define MAINFILE_HPP
+
+#include <assimp/Importer.hpp>
+
+#include "filelist.hpp"
+
+#include <vector>
+
+// Returns the indices of the files that could be the main file of the model,
+// the most probable ones first. Images, materials and other companion files
+// are left out, so the importer doesn't waste time on trying to read them.
+std::vector<size_t> GetMainFileCandidates (const FileList& fileList, const Assimp::Importer& importer);
+
+#endif
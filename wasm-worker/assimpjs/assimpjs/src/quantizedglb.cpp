@@ -0,0 +1,626 @@
+#include "quantizedglb.hpp"
+
+#include <assimp/material.h>
+
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const int GltfByte = 5120;
+static const int GltfUnsignedByte = 5121;
+static const int GltfShort = 5122;
+static const int GltfUnsignedShort = 5123;
+static const int GltfUnsignedInt = 5125;
+static const int GltfFloat = 5126;
+
+static const int GltfArrayBuffer = 34962;
+static const int GltfElementArrayBuffer = 34963;
+static const int GltfNoTarget = 0;
+
+static const int GltfModePoints = 0;
+static const int GltfModeLines = 1;
+static const int GltfModeTriangles = 4;
+
+static const std::uint32_t GlbMagic = 0x46546C67;
+static const std::uint32_t GlbVersion = 2;
+static const std::uint32_t GlbJsonChunk = 0x4E4F534A;
+static const std::uint32_t GlbBinaryChunk = 0x004E4942;
+
+static const std::uint32_t NoVertex = std::numeric_limits<std::uint32_t>::max ();
+
+static std::string EscapeJsonString (const std::string& str)
+{
+	std::string escaped;
+	for (char c : str) {
+		if (c == '"' || c == '\\') {
+			escaped.push_back ('\\');
+			escaped.push_back (c);
+		} else if ((unsigned char) c < 0x20) {
+			char code[8];
+			snprintf (code, sizeof (code), "\\u%04x", (unsigned int) c);
+			escaped += code;
+		} else {
+			escaped.push_back (c);
+		}
+	}
+	return escaped;
+}
+
+static const char* GetImageMimeType (const std::uint8_t* data, size_t size)
+{
+	if (size >= 4 && data[0] == 0x89 && data[1] == 'P' && data[2] == 'N' && data[3] == 'G') {
+		return "image/png";
+	}
+	if (size >= 2 && data[0] == 0xFF && data[1] == 0xD8) {
+		return "image/jpeg";
+	}
+	return nullptr;
+}
+
+static std::int16_t QuantizeSigned16 (float value)
+{
+	float clamped = std::max (-1.0f, std::min (1.0f, value));
+	return (std::int16_t) std::lround (clamped * 32767.0f);
+}
+
+static std::int8_t QuantizeSigned8 (float value)
+{
+	float clamped = std::max (-1.0f, std::min (1.0f, value));
+	return (std::int8_t) std::lround (clamped * 127.0f);
+}
+
+static std::uint16_t QuantizeUnsigned16 (float value)
+{
+	float clamped = std::max (0.0f, std::min (1.0f, value));
+	return (std::uint16_t) std::lround (clamped * 65535.0f);
+}
+
+static std::uint8_t QuantizeUnsigned8 (float value)
+{
+	float clamped = std::max (0.0f, std::min (1.0f, value));
+	return (std::uint8_t) std::lround (clamped * 255.0f);
+}
+
+class GltfNode
+{
+public:
+	GltfNode () :
+		name (),
+		hasMatrix (false),
+		matrix (),
+		mesh (-1),
+		children ()
+	{
+	}
+
+	std::string			name;
+	bool				hasMatrix;
+	float				matrix[16];
+	int					mesh;
+	std::vector<int>	children;
+};
+
+class MeshQuantization
+{
+public:
+	MeshQuantization () :
+		center (),
+		scale (1.0f)
+	{
+	}
+
+	aiVector3D	center;
+	float		scale;
+};
+
+class QuantizedGlbWriter
+{
+public:
+	QuantizedGlbWriter (const aiScene* scene, Assimp::IOSystem* ioSystem) :
+		scene (scene),
+		ioSystem (ioSystem),
+		binary (),
+		nodes (),
+		gltfMeshIndices (),
+		meshQuantizations (),
+		textureIndices (),
+		bufferViewCount (0),
+		accessorCount (0),
+		imageCount (0),
+		bufferViewsJson (),
+		accessorsJson (),
+		meshesJson (),
+		imagesJson ()
+	{
+		for (std::ostringstream* stream : { &bufferViewsJson, &accessorsJson, &meshesJson, &imagesJson }) {
+			*stream << std::setprecision (std::numeric_limits<float>::max_digits10);
+		}
+	}
+
+	bool Write (Buffer& output)
+	{
+		if (scene == nullptr || scene->mRootNode == nullptr) {
+			return false;
+		}
+
+		int gltfMeshCount = 0;
+		gltfMeshIndices.assign (scene->mNumMeshes, -1);
+		meshQuantizations.assign (scene->mNumMeshes, MeshQuantization ());
+		for (unsigned int meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++) {
+			const aiMesh* mesh = scene->mMeshes[meshIndex];
+			if (mesh->mNumVertices == 0) {
+				continue;
+			}
+			meshesJson << (gltfMeshCount > 0 ? "," : "");
+			WriteMesh (mesh, meshQuantizations[meshIndex]);
+			gltfMeshIndices[meshIndex] = gltfMeshCount++;
+		}
+
+		std::string materialsJson = WriteMaterials ();
+		AddNode (scene->mRootNode);
+
+		std::ostringstream json;
+		json << std::setprecision (std::numeric_limits<float>::max_digits10);
+		json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"assimpjs\"},";
+		json << "\"extensionsUsed\":[\"KHR_mesh_quantization\"],";
+		json << "\"extensionsRequired\":[\"KHR_mesh_quantization\"],";
+		json << "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],";
+		json << "\"nodes\":[";
+		for (size_t nodeIndex = 0; nodeIndex < nodes.size (); nodeIndex++) {
+			WriteNode (json, nodes[nodeIndex], nodeIndex > 0);
+		}
+		json << "]";
+		if (gltfMeshCount > 0) {
+			json << ",\"meshes\":[" << meshesJson.str () << "]";
+			json << ",\"accessors\":[" << accessorsJson.str () << "]";
+		}
+		if (!materialsJson.empty ()) {
+			json << ",\"materials\":[" << materialsJson << "]";
+		}
+		if (imageCount > 0) {
+			json << ",\"images\":[" << imagesJson.str () << "]";
+			json << ",\"textures\":[";
+			for (int imageIndex = 0; imageIndex < imageCount; imageIndex++) {
+				json << (imageIndex > 0 ? "," : "") << "{\"source\":" << imageIndex << "}";
+			}
+			json << "]";
+		}
+		if (bufferViewCount > 0) {
+			json << ",\"bufferViews\":[" << bufferViewsJson.str () << "]";
+			json << ",\"buffers\":[{\"byteLength\":" << binary.size () << "}]";
+		}
+		json << "}";
+
+		WriteGlb (json.str (), output);
+		return true;
+	}
+
+private:
+	int AddNode (const aiNode* node)
+	{
+		int nodeIndex = (int) nodes.size ();
+		nodes.push_back (GltfNode ());
+		nodes[nodeIndex].name = node->mName.C_Str ();
+		if (!node->mTransformation.IsIdentity ()) {
+			const aiMatrix4x4& m = node->mTransformation;
+			float matrix[16] = {
+				m.a1, m.b1, m.c1, m.d1,
+				m.a2, m.b2, m.c2, m.d2,
+				m.a3, m.b3, m.c3, m.d3,
+				m.a4, m.b4, m.c4, m.d4
+			};
+			nodes[nodeIndex].hasMatrix = true;
+			std::memcpy (nodes[nodeIndex].matrix, matrix, sizeof (matrix));
+		}
+
+		// every mesh gets its own child node, because it holds the transformation
+		// that converts the quantized positions back to the original range
+		for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+			unsigned int meshIndex = node->mMeshes[i];
+			if (meshIndex >= scene->mNumMeshes || gltfMeshIndices[meshIndex] == -1) {
+				continue;
+			}
+			const MeshQuantization& quantization = meshQuantizations[meshIndex];
+			GltfNode meshNode;
+			meshNode.mesh = gltfMeshIndices[meshIndex];
+			meshNode.hasMatrix = true;
+			float matrix[16] = {
+				quantization.scale, 0.0f, 0.0f, 0.0f,
+				0.0f, quantization.scale, 0.0f, 0.0f,
+				0.0f, 0.0f, quantization.scale, 0.0f,
+				quantization.center.x, quantization.center.y, quantization.center.z, 1.0f
+			};
+			std::memcpy (meshNode.matrix, matrix, sizeof (matrix));
+			int meshNodeIndex = (int) nodes.size ();
+			nodes.push_back (meshNode);
+			nodes[nodeIndex].children.push_back (meshNodeIndex);
+		}
+
+		for (unsigned int i = 0; i < node->mNumChildren; i++) {
+			int childIndex = AddNode (node->mChildren[i]);
+			nodes[nodeIndex].children.push_back (childIndex);
+		}
+		return nodeIndex;
+	}
+
+	void WriteNode (std::ostringstream& json, const GltfNode& node, bool separator)
+	{
+		json << (separator ? "," : "") << "{";
+		json << "\"name\":\"" << EscapeJsonString (node.name) << "\"";
+		if (node.mesh != -1) {
+			json << ",\"mesh\":" << node.mesh;
+		}
+		if (node.hasMatrix) {
+			json << ",\"matrix\":[";
+			for (int i = 0; i < 16; i++) {
+				json << (i > 0 ? "," : "") << node.matrix[i];
+			}
+			json << "]";
+		}
+		if (!node.children.empty ()) {
+			json << ",\"children\":[";
+			for (size_t i = 0; i < node.children.size (); i++) {
+				json << (i > 0 ? "," : "") << node.children[i];
+			}
+			json << "]";
+		}
+		json << "}";
+	}
+
+	void WriteMesh (const aiMesh* mesh, MeshQuantization& quantization)
+	{
+		int mode = GltfModePoints;
+		unsigned int faceSize = 1;
+		if (mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE) {
+			mode = GltfModeTriangles;
+			faceSize = 3;
+		} else if (mesh->mPrimitiveTypes & aiPrimitiveType_LINE) {
+			mode = GltfModeLines;
+			faceSize = 2;
+		}
+
+		// vertices are reordered by their first use in the index buffer, so the
+		// vertex fetches follow the order of the (cache optimized) triangles
+		std::vector<std::uint32_t> indices;
+		std::vector<std::uint32_t> vertexRemap (mesh->mNumVertices, NoVertex);
+		std::vector<std::uint32_t> vertexOrder;
+		for (unsigned int faceIndex = 0; faceIndex < mesh->mNumFaces; faceIndex++) {
+			const aiFace& face = mesh->mFaces[faceIndex];
+			if (face.mNumIndices != faceSize) {
+				continue;
+			}
+			for (unsigned int i = 0; i < face.mNumIndices; i++) {
+				std::uint32_t vertexIndex = face.mIndices[i];
+				if (vertexRemap[vertexIndex] == NoVertex) {
+					vertexRemap[vertexIndex] = (std::uint32_t) vertexOrder.size ();
+					vertexOrder.push_back (vertexIndex);
+				}
+				indices.push_back (vertexRemap[vertexIndex]);
+			}
+		}
+		bool hasIndices = !indices.empty ();
+		if (!hasIndices) {
+			mode = GltfModePoints;
+			for (unsigned int vertexIndex = 0; vertexIndex < mesh->mNumVertices; vertexIndex++) {
+				vertexOrder.push_back (vertexIndex);
+			}
+		}
+
+		aiVector3D boxMin = mesh->mVertices[vertexOrder[0]];
+		aiVector3D boxMax = boxMin;
+		for (std::uint32_t vertexIndex : vertexOrder) {
+			const aiVector3D& position = mesh->mVertices[vertexIndex];
+			boxMin = aiVector3D (std::min (boxMin.x, position.x), std::min (boxMin.y, position.y), std::min (boxMin.z, position.z));
+			boxMax = aiVector3D (std::max (boxMax.x, position.x), std::max (boxMax.y, position.y), std::max (boxMax.z, position.z));
+		}
+
+		// the scale is the same on every axis, so normals don't need to be corrected
+		quantization.center = aiVector3D ((boxMin.x + boxMax.x) / 2.0f, (boxMin.y + boxMax.y) / 2.0f, (boxMin.z + boxMax.z) / 2.0f);
+		quantization.scale = std::max ({ boxMax.x - boxMin.x, boxMax.y - boxMin.y, boxMax.z - boxMin.z }) / 2.0f;
+		if (!(quantization.scale > 0.0f)) {
+			quantization.scale = 1.0f;
+		}
+
+		size_t vertexCount = vertexOrder.size ();
+		meshesJson << "{\"name\":\"" << EscapeJsonString (mesh->mName.C_Str ()) << "\",\"primitives\":[{\"attributes\":{";
+		meshesJson << "\"POSITION\":" << WritePositions (mesh, vertexOrder, quantization);
+		if (mesh->HasNormals ()) {
+			meshesJson << ",\"NORMAL\":" << WriteNormals (mesh, vertexOrder);
+		}
+		int texCoordCount = 0;
+		for (unsigned int channel = 0; channel < AI_MAX_NUMBER_OF_TEXTURECOORDS && texCoordCount < 2; channel++) {
+			if (mesh->HasTextureCoords (channel) && mesh->mNumUVComponents[channel] >= 2) {
+				meshesJson << ",\"TEXCOORD_" << texCoordCount << "\":" << WriteTexCoords (mesh, channel, vertexOrder);
+				texCoordCount++;
+			}
+		}
+		if (mesh->HasVertexColors (0)) {
+			meshesJson << ",\"COLOR_0\":" << WriteColors (mesh, vertexOrder);
+		}
+		meshesJson << "}";
+		if (hasIndices) {
+			meshesJson << ",\"indices\":" << WriteIndices (indices, vertexCount);
+		}
+		meshesJson << ",\"mode\":" << mode;
+		if (mesh->mMaterialIndex < scene->mNumMaterials) {
+			meshesJson << ",\"material\":" << mesh->mMaterialIndex;
+		}
+		meshesJson << "}]}";
+	}
+
+	int WritePositions (const aiMesh* mesh, const std::vector<std::uint32_t>& vertexOrder, const MeshQuantization& quantization)
+	{
+		// vertex attributes have to be aligned to four bytes, so the fourth component is padding
+		std::vector<std::int16_t> values (vertexOrder.size () * 4, 0);
+		std::int16_t min[3] = { 32767, 32767, 32767 };
+		std::int16_t max[3] = { -32767, -32767, -32767 };
+		for (size_t i = 0; i < vertexOrder.size (); i++) {
+			const aiVector3D& position = mesh->mVertices[vertexOrder[i]];
+			std::int16_t quantized[3] = {
+				QuantizeSigned16 ((position.x - quantization.center.x) / quantization.scale),
+				QuantizeSigned16 ((position.y - quantization.center.y) / quantization.scale),
+				QuantizeSigned16 ((position.z - quantization.center.z) / quantization.scale)
+			};
+			for (int component = 0; component < 3; component++) {
+				values[i * 4 + component] = quantized[component];
+				min[component] = std::min (min[component], quantized[component]);
+				max[component] = std::max (max[component], quantized[component]);
+			}
+		}
+		int bufferView = AddBufferView (values.data (), values.size () * sizeof (std::int16_t), 8, GltfArrayBuffer);
+		std::ostringstream bounds;
+		bounds << ",\"min\":[" << min[0] << "," << min[1] << "," << min[2] << "]";
+		bounds << ",\"max\":[" << max[0] << "," << max[1] << "," << max[2] << "]";
+		return AddAccessor (bufferView, GltfShort, true, vertexOrder.size (), "VEC3", bounds.str ());
+	}
+
+	int WriteNormals (const aiMesh* mesh, const std::vector<std::uint32_t>& vertexOrder)
+	{
+		std::vector<std::int8_t> values (vertexOrder.size () * 4, 0);
+		for (size_t i = 0; i < vertexOrder.size (); i++) {
+			aiVector3D normal = mesh->mNormals[vertexOrder[i]];
+			float length = normal.Length ();
+			if (length > 0.0f) {
+				normal = aiVector3D (normal.x / length, normal.y / length, normal.z / length);
+			}
+			values[i * 4 + 0] = QuantizeSigned8 (normal.x);
+			values[i * 4 + 1] = QuantizeSigned8 (normal.y);
+			values[i * 4 + 2] = QuantizeSigned8 (normal.z);
+		}
+		int bufferView = AddBufferView (values.data (), values.size (), 4, GltfArrayBuffer);
+		return AddAccessor (bufferView, GltfByte, true, vertexOrder.size (), "VEC3", std::string ());
+	}
+
+	int WriteTexCoords (const aiMesh* mesh, unsigned int channel, const std::vector<std::uint32_t>& vertexOrder)
+	{
+		// gltf has the texture origin in the top left corner, assimp in the bottom left
+		std::vector<float> values (vertexOrder.size () * 2);
+		bool inUnitRange = true;
+		for (size_t i = 0; i < vertexOrder.size (); i++) {
+			const aiVector3D& texCoord = mesh->mTextureCoords[channel][vertexOrder[i]];
+			values[i * 2 + 0] = texCoord.x;
+			values[i * 2 + 1] = 1.0f - texCoord.y;
+			for (int component = 0; component < 2; component++) {
+				float value = values[i * 2 + component];
+				if (!(value >= 0.0f && value <= 1.0f)) {
+					inUnitRange = false;
+				}
+			}
+		}
+
+		// repeating texture coordinates would need a texture transform to quantize
+		if (!inUnitRange) {
+			int bufferView = AddBufferView (values.data (), values.size () * sizeof (float), 0, GltfArrayBuffer);
+			return AddAccessor (bufferView, GltfFloat, false, vertexOrder.size (), "VEC2", std::string ());
+		}
+
+		std::vector<std::uint16_t> quantized (values.size ());
+		for (size_t i = 0; i < values.size (); i++) {
+			quantized[i] = QuantizeUnsigned16 (values[i]);
+		}
+		int bufferView = AddBufferView (quantized.data (), quantized.size () * sizeof (std::uint16_t), 0, GltfArrayBuffer);
+		return AddAccessor (bufferView, GltfUnsignedShort, true, vertexOrder.size (), "VEC2", std::string ());
+	}
+
+	int WriteColors (const aiMesh* mesh, const std::vector<std::uint32_t>& vertexOrder)
+	{
+		std::vector<std::uint8_t> values (vertexOrder.size () * 4);
+		for (size_t i = 0; i < vertexOrder.size (); i++) {
+			const aiColor4D& color = mesh->mColors[0][vertexOrder[i]];
+			values[i * 4 + 0] = QuantizeUnsigned8 (color.r);
+			values[i * 4 + 1] = QuantizeUnsigned8 (color.g);
+			values[i * 4 + 2] = QuantizeUnsigned8 (color.b);
+			values[i * 4 + 3] = QuantizeUnsigned8 (color.a);
+		}
+		int bufferView = AddBufferView (values.data (), values.size (), 0, GltfArrayBuffer);
+		return AddAccessor (bufferView, GltfUnsignedByte, true, vertexOrder.size (), "VEC4", std::string ());
+	}
+
+	int WriteIndices (const std::vector<std::uint32_t>& indices, size_t vertexCount)
+	{
+		// the largest value of the component type is reserved for primitive restart
+		if (vertexCount < 65535) {
+			std::vector<std::uint16_t> shortIndices (indices.begin (), indices.end ());
+			int bufferView = AddBufferView (shortIndices.data (), shortIndices.size () * sizeof (std::uint16_t), 0, GltfElementArrayBuffer);
+			return AddAccessor (bufferView, GltfUnsignedShort, false, indices.size (), "SCALAR", std::string ());
+		}
+		int bufferView = AddBufferView (indices.data (), indices.size () * sizeof (std::uint32_t), 0, GltfElementArrayBuffer);
+		return AddAccessor (bufferView, GltfUnsignedInt, false, indices.size (), "SCALAR", std::string ());
+	}
+
+	std::string WriteMaterials ()
+	{
+		std::ostringstream json;
+		json << std::setprecision (std::numeric_limits<float>::max_digits10);
+		for (unsigned int materialIndex = 0; materialIndex < scene->mNumMaterials; materialIndex++) {
+			const aiMaterial* material = scene->mMaterials[materialIndex];
+
+			aiString name;
+			material->Get (AI_MATKEY_NAME, name);
+			aiColor4D diffuse (1.0f, 1.0f, 1.0f, 1.0f);
+			material->Get (AI_MATKEY_COLOR_DIFFUSE, diffuse);
+			float opacity = 1.0f;
+			material->Get (AI_MATKEY_OPACITY, opacity);
+			int twoSided = 0;
+			material->Get (AI_MATKEY_TWOSIDED, twoSided);
+
+			int textureIndex = -1;
+			aiString texturePath;
+			if (material->GetTextureCount (aiTextureType_DIFFUSE) > 0 && material->GetTexture (aiTextureType_DIFFUSE, 0, &texturePath) == aiReturn_SUCCESS) {
+				textureIndex = GetTextureIndex (texturePath.C_Str ());
+			}
+
+			float alpha = diffuse.a * opacity;
+			json << (materialIndex > 0 ? "," : "") << "{\"name\":\"" << EscapeJsonString (name.C_Str ()) << "\"";
+			json << ",\"pbrMetallicRoughness\":{\"baseColorFactor\":[" << diffuse.r << "," << diffuse.g << "," << diffuse.b << "," << alpha << "]";
+			if (textureIndex != -1) {
+				json << ",\"baseColorTexture\":{\"index\":" << textureIndex << "}";
+			}
+			json << ",\"metallicFactor\":0}";
+			if (alpha < 1.0f) {
+				json << ",\"alphaMode\":\"BLEND\"";
+			}
+			if (twoSided != 0) {
+				json << ",\"doubleSided\":true";
+			}
+			json << "}";
+		}
+		return json.str ();
+	}
+
+	int GetTextureIndex (const std::string& texturePath)
+	{
+		auto found = textureIndices.find (texturePath);
+		if (found != textureIndices.end ()) {
+			return found->second;
+		}
+
+		Buffer content;
+		const aiTexture* embeddedTexture = scene->GetEmbeddedTexture (texturePath.c_str ());
+		if (embeddedTexture != nullptr) {
+			// uncompressed embedded textures would have to be encoded first
+			if (embeddedTexture->mHeight == 0) {
+				const std::uint8_t* data = (const std::uint8_t*) embeddedTexture->pcData;
+				content.assign (data, data + embeddedTexture->mWidth);
+			}
+		} else if (ioSystem != nullptr && ioSystem->Exists (texturePath.c_str ())) {
+			Assimp::IOStream* stream = ioSystem->Open (texturePath.c_str (), "rb");
+			if (stream != nullptr) {
+				content.resize (stream->FileSize ());
+				if (!content.empty ()) {
+					content.resize (stream->Read (content.data (), 1, content.size ()));
+				}
+				ioSystem->Close (stream);
+			}
+		}
+
+		int textureIndex = -1;
+		const char* mimeType = GetImageMimeType (content.data (), content.size ());
+		if (mimeType != nullptr) {
+			int bufferView = AddBufferView (content.data (), content.size (), 0, GltfNoTarget);
+			imagesJson << (imageCount > 0 ? "," : "") << "{\"bufferView\":" << bufferView << ",\"mimeType\":\"" << mimeType << "\"}";
+			textureIndex = imageCount++;
+		}
+		textureIndices.insert ({ texturePath, textureIndex });
+		return textureIndex;
+	}
+
+	int AddBufferView (const void* data, size_t byteLength, int byteStride, int target)
+	{
+		while (binary.size () % 4 != 0) {
+			binary.push_back (0);
+		}
+		size_t byteOffset = binary.size ();
+		binary.resize (byteOffset + byteLength);
+		if (byteLength > 0) {
+			std::memcpy (binary.data () + byteOffset, data, byteLength);
+		}
+
+		bufferViewsJson << (bufferViewCount > 0 ? "," : "");
+		bufferViewsJson << "{\"buffer\":0,\"byteOffset\":" << byteOffset << ",\"byteLength\":" << byteLength;
+		if (byteStride > 0) {
+			bufferViewsJson << ",\"byteStride\":" << byteStride;
+		}
+		if (target != GltfNoTarget) {
+			bufferViewsJson << ",\"target\":" << target;
+		}
+		bufferViewsJson << "}";
+		return bufferViewCount++;
+	}
+
+	int AddAccessor (int bufferView, int componentType, bool normalized, size_t count, const std::string& type, const std::string& bounds)
+	{
+		accessorsJson << (accessorCount > 0 ? "," : "");
+		accessorsJson << "{\"bufferView\":" << bufferView << ",\"componentType\":" << componentType;
+		if (normalized) {
+			accessorsJson << ",\"normalized\":true";
+		}
+		accessorsJson << ",\"count\":" << count << ",\"type\":\"" << type << "\"" << bounds << "}";
+		return accessorCount++;
+	}
+
+	void WriteGlb (const std::string& json, Buffer& output)
+	{
+		// glb chunks have to be aligned to four bytes, json is padded with spaces
+		std::string jsonChunk = json;
+		while (jsonChunk.size () % 4 != 0) {
+			jsonChunk.push_back (' ');
+		}
+		while (binary.size () % 4 != 0) {
+			binary.push_back (0);
+		}
+
+		std::uint32_t totalLength = 12 + 8 + (std::uint32_t) jsonChunk.size ();
+		if (!binary.empty ()) {
+			totalLength += 8 + (std::uint32_t) binary.size ();
+		}
+
+		output.clear ();
+		output.reserve (totalLength);
+		WriteUInt32 (output, GlbMagic);
+		WriteUInt32 (output, GlbVersion);
+		WriteUInt32 (output, totalLength);
+
+		WriteUInt32 (output, (std::uint32_t) jsonChunk.size ());
+		WriteUInt32 (output, GlbJsonChunk);
+		output.insert (output.end (), jsonChunk.begin (), jsonChunk.end ());
+
+		if (!binary.empty ()) {
+			WriteUInt32 (output, (std::uint32_t) binary.size ());
+			WriteUInt32 (output, GlbBinaryChunk);
+			output.insert (output.end (), binary.begin (), binary.end ());
+		}
+	}
+
+	static void WriteUInt32 (Buffer& output, std::uint32_t value)
+	{
+		// glb is little endian just like all of our target platforms
+		const std::uint8_t* bytes = (const std::uint8_t*) &value;
+		output.insert (output.end (), bytes, bytes + sizeof (value));
+	}
+
+	const aiScene*							scene;
+	Assimp::IOSystem*						ioSystem;
+	Buffer									binary;
+	std::vector<GltfNode>					nodes;
+	std::vector<int>						gltfMeshIndices;
+	std::vector<MeshQuantization>			meshQuantizations;
+	std::unordered_map<std::string, int>	textureIndices;
+	int										bufferViewCount;
+	int										accessorCount;
+	int										imageCount;
+	std::ostringstream						bufferViewsJson;
+	std::ostringstream						accessorsJson;
+	std::ostringstream						meshesJson;
+	std::ostringstream						imagesJson;
+};
+
+bool WriteQuantizedGlb (const aiScene* scene, Assimp::IOSystem* ioSystem, Buffer& output)
+{
+	QuantizedGlbWriter writer (scene, ioSystem);
+	return writer.Write (output);
+}
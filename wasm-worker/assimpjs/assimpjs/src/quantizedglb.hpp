@@ -0,0 +1,17 @@
+#ifndef QUANTIZEDGLB_HPP
+#define QUANTIZEDGLB_HPP
+
+#include <assimp/IOSystem.hpp>
+#include <assimp/scene.h>
+
+#include "filelist.hpp"
+
+// Writes the scene as a binary glTF with KHR_mesh_quantization. Positions are
+// stored as normalized 16-bit integers relative to the bounding box of the mesh,
+// normals as normalized 8-bit integers, and texture coordinates as normalized
+// 16-bit integers if they are in the [0, 1] range. Indices are 16-bit if the
+// mesh has less than 65536 vertices, and vertices are reordered by first use.
+// External textures are read through the given io system and embedded.
+bool WriteQuantizedGlb (const aiScene* scene, Assimp::IOSystem* ioSystem, Buffer& output);
+
+#endif
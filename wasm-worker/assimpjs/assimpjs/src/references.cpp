@@ -0,0 +1,201 @@
+#include "references.hpp"
+
+#include <cstring>
+#include <cctype>
+
+static const char* MaterialTextureKeywords[] = {
+	"map_Ka", "map_Kd", "map_Ks", "map_Ke", "map_Ns", "map_d", "map_bump", "map_Bump",
+	"bump", "disp", "decal", "refl", "norm", "map_Pr", "map_Pm", "map_Ps"
+};
+
+static std::string GetExtension (const std::string& fileName)
+{
+	size_t lastDot = fileName.find_last_of ('.');
+	if (lastDot == std::string::npos) {
+		return std::string ();
+	}
+	return fileName.substr (lastDot + 1);
+}
+
+static std::string TrimWhitespace (const std::string& str)
+{
+	size_t first = 0;
+	while (first < str.length () && std::isspace ((unsigned char) str[first])) {
+		first++;
+	}
+	size_t last = str.length ();
+	while (last > first && std::isspace ((unsigned char) str[last - 1])) {
+		last--;
+	}
+	return str.substr (first, last - first);
+}
+
+static std::string NormalizePath (const std::string& path)
+{
+	// the relative path is kept with forward slashes, so it can be resolved
+	// against the folder of the referring file
+	std::string normalized = path;
+	for (char& c : normalized) {
+		if (c == '\\') {
+			c = '/';
+		}
+	}
+	return normalized;
+}
+
+static int GetHexDigitValue (char c)
+{
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	} else if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	} else if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+static std::string DecodeUri (const std::string& uri)
+{
+	// percent escapes only, invalid ones are kept as they are
+	std::string decoded;
+	decoded.reserve (uri.length ());
+	for (size_t i = 0; i < uri.length (); i++) {
+		if (uri[i] == '%' && i + 2 < uri.length ()) {
+			int high = GetHexDigitValue (uri[i + 1]);
+			int low = GetHexDigitValue (uri[i + 2]);
+			if (high != -1 && low != -1) {
+				decoded.push_back ((char) (high * 16 + low));
+				i += 2;
+				continue;
+			}
+		}
+		decoded.push_back (uri[i]);
+	}
+	return decoded;
+}
+
+static void AddReference (std::vector<std::string>& references, const std::string& path)
+{
+	std::string trimmedPath = TrimWhitespace (path);
+	if (trimmedPath.empty ()) {
+		return;
+	}
+	// the delay load callbacks get only the file name, so the same name in
+	// different folders would refer to the same file anyway
+	std::string filePath = NormalizePath (trimmedPath);
+	for (const std::string& reference : references) {
+		if (IsSameFileName (reference.c_str (), filePath.c_str ())) {
+			return;
+		}
+	}
+	references.push_back (filePath);
+}
+
+template <typename LineHandler>
+static void EnumerateLines (const char* text, size_t length, LineHandler onLine)
+{
+	size_t lineStart = 0;
+	while (lineStart < length) {
+		const char* lineEnd = (const char*) std::memchr (text + lineStart, '\n', length - lineStart);
+		size_t lineLength = (lineEnd != nullptr ? (size_t) (lineEnd - text) : length) - lineStart;
+		onLine (std::string (text + lineStart, lineLength));
+		lineStart += lineLength + 1;
+	}
+}
+
+static bool StartsWithKeyword (const std::string& line, const char* keyword, std::string& rest)
+{
+	size_t keywordLength = std::strlen (keyword);
+	if (line.length () <= keywordLength || line.compare (0, keywordLength, keyword) != 0) {
+		return false;
+	}
+	if (!std::isspace ((unsigned char) line[keywordLength])) {
+		return false;
+	}
+	rest = line.substr (keywordLength + 1);
+	return true;
+}
+
+static void GetObjReferences (const char* text, size_t length, std::vector<std::string>& references)
+{
+	EnumerateLines (text, length, [&] (const std::string& line) {
+		std::string rest;
+		if (StartsWithKeyword (TrimWhitespace (line), "mtllib", rest)) {
+			AddReference (references, rest);
+		}
+	});
+}
+
+static void GetMtlReferences (const char* text, size_t length, std::vector<std::string>& references)
+{
+	EnumerateLines (text, length, [&] (const std::string& line) {
+		std::string trimmedLine = TrimWhitespace (line);
+		for (const char* keyword : MaterialTextureKeywords) {
+			std::string rest;
+			if (!StartsWithKeyword (trimmedLine, keyword, rest)) {
+				continue;
+			}
+			// texture options like -bm 1.0 come before the file name
+			std::string value = TrimWhitespace (rest);
+			size_t lastSpace = value.find_last_of (" \t");
+			AddReference (references, lastSpace == std::string::npos ? value : value.substr (lastSpace + 1));
+			break;
+		}
+	});
+}
+
+static void GetGltfReferences (const char* text, size_t length, std::vector<std::string>& references)
+{
+	// a simple scan for "uri" keys is enough, embedded data uris are skipped
+	static const char uriKey[] = "\"uri\"";
+	std::string json (text, length);
+	size_t position = json.find (uriKey);
+	while (position != std::string::npos) {
+		size_t valueStart = json.find ('"', json.find (':', position + sizeof (uriKey) - 1));
+		if (valueStart == std::string::npos) {
+			break;
+		}
+		size_t valueEnd = json.find ('"', valueStart + 1);
+		if (valueEnd == std::string::npos) {
+			break;
+		}
+		std::string uri = json.substr (valueStart + 1, valueEnd - valueStart - 1);
+		if (uri.compare (0, 5, "data:") != 0) {
+			AddReference (references, DecodeUri (uri));
+		}
+		position = json.find (uriKey, valueEnd);
+	}
+}
+
+static void GetGlbReferences (const Buffer& content, std::vector<std::string>& references)
+{
+	// header (12 bytes), then the json chunk length and type (8 bytes)
+	if (content.size () < 20 || std::memcmp (content.data (), "glTF", 4) != 0) {
+		return;
+	}
+	std::uint32_t jsonLength = 0;
+	std::memcpy (&jsonLength, content.data () + 12, sizeof (jsonLength));
+	if (jsonLength > content.size () - 20) {
+		return;
+	}
+	GetGltfReferences ((const char*) content.data () + 20, jsonLength, references);
+}
+
+std::vector<std::string> GetReferencedFileNames (const File& file)
+{
+	std::vector<std::string> references;
+	const Buffer& content = file.GetContent ();
+	const char* text = (const char*) content.data ();
+	std::string extension = GetExtension (GetFileName (file.path));
+	if (extension == "obj") {
+		GetObjReferences (text, content.size (), references);
+	} else if (extension == "mtl") {
+		GetMtlReferences (text, content.size (), references);
+	} else if (extension == "gltf") {
+		GetGltfReferences (text, content.size (), references);
+	} else if (extension == "glb") {
+		GetGlbReferences (content, references);
+	}
+	return references;
+}
@@ -0,0 +1,19 @@
+#ifndef REFERENCES_HPP
+#define REFERENCES_HPP
+
+#include "filelist.hpp"
+
+#include <vector>
+#include <string>
+
+// Returns the paths of the external files the given file refers to, so they
+// can be fetched in parallel before the conversion. Only a quick text scan is
+// done for formats that commonly come in multiple files (obj, mtl, gltf, glb).
+// The paths are relative to the referring file, they keep their case, use
+// forward slashes, and gltf uris are percent-decoded. The delay load callbacks
+// get only the lowercase file name, so files with the same name are returned once.
+// Referenced files may have references on their own, e.g. the textures of an
+// mtl file, so the scan can be repeated on the fetched files.
+std::vector<std::string> GetReferencedFileNames (const File& file);
+
+#endif
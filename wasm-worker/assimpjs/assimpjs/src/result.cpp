@@ -1,5 +1,13 @@
 #include "result.hpp"
 
+#include <algorithm>
+
+StepTime::StepTime (const std::string& name, double milliseconds) :
+	name (name),
+	milliseconds (milliseconds)
+{
+}
+
 Result::Result () :
 	Result (ErrorCode::UnknownError)
 {
@@ -7,7 +15,9 @@ Result::Result () :
 
 Result::Result (ErrorCode error) :
 	errorCode (error),
-	fileList ()
+	fileList (),
+	stepTimes (),
+	readPositions ()
 {
 }
 
@@ -43,3 +53,65 @@ const File& Result::GetFile (size_t index) const
 {
 	return fileList.GetFile (index);
 }
+
+size_t Result::GetFileSize (size_t index) const
+{
+	return fileList.GetFile (index).GetContent ().size ();
+}
+
+size_t Result::ReadFileChunk (size_t index, size_t maxSize, const std::uint8_t*& chunk)
+{
+	if (readPositions.size () < fileList.FileCount ()) {
+		readPositions.resize (fileList.FileCount (), 0);
+	}
+
+	// the chunk points into the file content, so the content is released only
+	// on the call after the last chunk, when nothing refers to it anymore
+	File& file = fileList.GetFile (index);
+	const Buffer& content = file.GetContent ();
+	size_t& readPosition = readPositions[index];
+	if (readPosition >= content.size ()) {
+		file.content = std::make_shared<const Buffer> ();
+		readPosition = 0;
+		chunk = nullptr;
+		return 0;
+	}
+
+	size_t chunkSize = std::min (maxSize, content.size () - readPosition);
+	chunk = content.data () + readPosition;
+	readPosition += chunkSize;
+	return chunkSize;
+}
+
+size_t Result::StepCount () const
+{
+	return stepTimes.size ();
+}
+
+std::string Result::GetStepName (size_t index) const
+{
+	return stepTimes[index].name;
+}
+
+double Result::GetStepTime (size_t index) const
+{
+	return stepTimes[index].milliseconds;
+}
+
+void Result::AddStepTime (const std::string& name, double milliseconds)
+{
+	stepTimes.push_back (StepTime (name, milliseconds));
+}
+
+#ifdef EMSCRIPTEN
+
+emscripten::val Result::ReadFileChunkEmscripten (size_t index, size_t maxSize)
+{
+	// the Uint8Array constructor copies the view, so the chunk is owned by javascript
+	const std::uint8_t* chunk = nullptr;
+	size_t chunkSize = ReadFileChunk (index, maxSize, chunk);
+	emscripten::val Uint8Array = emscripten::val::global ("Uint8Array");
+	return Uint8Array.new_ (emscripten::typed_memory_view (chunkSize, chunk));
+}
+
+#endif
@@ -1,8 +1,15 @@
 #ifndef RESULT_HPP
 #define RESULT_HPP
 
+#ifdef EMSCRIPTEN
+#include <emscripten/bind.h>
+#endif
+
 #include "filelist.hpp"
 
+#include <vector>
+#include <string>
+
 enum class ErrorCode : int
 {
 	NoError = 0,
@@ -12,6 +19,15 @@ enum class ErrorCode : int
 	UnknownError = 4
 };
 
+class StepTime
+{
+public:
+	StepTime (const std::string& name, double milliseconds);
+
+	std::string			name;
+	double				milliseconds;
+};
+
 class Result
 {
 public:
@@ -24,8 +40,22 @@ public:
 	size_t				FileCount () const;
 	const File&			GetFile (size_t index) const;
 
-	ErrorCode			errorCode;
-	FileList			fileList;
+	size_t				GetFileSize (size_t index) const;
+	size_t				ReadFileChunk (size_t index, size_t maxSize, const std::uint8_t*& chunk);
+
+	size_t				StepCount () const;
+	std::string			GetStepName (size_t index) const;
+	double				GetStepTime (size_t index) const;
+	void				AddStepTime (const std::string& name, double milliseconds);
+
+#ifdef EMSCRIPTEN
+	emscripten::val		ReadFileChunkEmscripten (size_t index, size_t maxSize);
+#endif
+
+	ErrorCode				errorCode;
+	FileList				fileList;
+	std::vector<StepTime>	stepTimes;
+	std::vector<size_t>		readPositions;
 };
 
 #endif
@@ -0,0 +1,181 @@
+#include "statistics.hpp"
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#ifndef EMSCRIPTEN
+#include <thread>
+#include <system_error>
+#endif
+
+static const unsigned int MaxDefaultThreadCount = 4;
+
+class MeshInstance
+{
+public:
+	const aiMesh*		mesh;
+	aiMatrix4x4			transformation;
+};
+
+static void CollectMeshInstances (const aiScene* scene, const aiNode* node, const aiMatrix4x4& parentTransformation, std::vector<MeshInstance>& instances)
+{
+	aiMatrix4x4 transformation = parentTransformation * node->mTransformation;
+	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+		unsigned int meshIndex = node->mMeshes[i];
+		if (meshIndex < scene->mNumMeshes) {
+			instances.push_back ({ scene->mMeshes[meshIndex], transformation });
+		}
+	}
+	for (unsigned int i = 0; i < node->mNumChildren; i++) {
+		CollectMeshInstances (scene, node->mChildren[i], transformation, instances);
+	}
+}
+
+static void AddMeshInstance (const MeshInstance& instance, SceneStatistics& statistics)
+{
+	const aiMesh* mesh = instance.mesh;
+	std::vector<aiVector3D> positions (mesh->mNumVertices);
+	for (unsigned int vertexIndex = 0; vertexIndex < mesh->mNumVertices; vertexIndex++) {
+		const aiVector3D& position = instance.transformation * mesh->mVertices[vertexIndex];
+		positions[vertexIndex] = position;
+		double coordinates[3] = { position.x, position.y, position.z };
+		for (int i = 0; i < 3; i++) {
+			statistics.boundingBoxMin[i] = std::min (statistics.boundingBoxMin[i], coordinates[i]);
+			statistics.boundingBoxMax[i] = std::max (statistics.boundingBoxMax[i], coordinates[i]);
+		}
+	}
+
+	statistics.meshInstanceCount += 1;
+	statistics.vertexCount += mesh->mNumVertices;
+	for (unsigned int faceIndex = 0; faceIndex < mesh->mNumFaces; faceIndex++) {
+		const aiFace& face = mesh->mFaces[faceIndex];
+		if (face.mNumIndices < 3) {
+			continue;
+		}
+		statistics.triangleCount += face.mNumIndices - 2;
+		const aiVector3D& origin = positions[face.mIndices[0]];
+		for (unsigned int i = 1; i + 1 < face.mNumIndices; i++) {
+			aiVector3D edge1 = positions[face.mIndices[i]] - origin;
+			aiVector3D edge2 = positions[face.mIndices[i + 1]] - origin;
+			statistics.surfaceArea += (edge1 ^ edge2).Length () / 2.0;
+		}
+	}
+}
+
+static void MergeStatistics (const SceneStatistics& source, SceneStatistics& target)
+{
+	target.meshInstanceCount += source.meshInstanceCount;
+	target.vertexCount += source.vertexCount;
+	target.triangleCount += source.triangleCount;
+	target.surfaceArea += source.surfaceArea;
+	for (int i = 0; i < 3; i++) {
+		target.boundingBoxMin[i] = std::min (target.boundingBoxMin[i], source.boundingBoxMin[i]);
+		target.boundingBoxMax[i] = std::max (target.boundingBoxMax[i], source.boundingBoxMax[i]);
+	}
+}
+
+SceneStatistics::SceneStatistics () :
+	SceneStatistics (ErrorCode::UnknownError)
+{
+}
+
+SceneStatistics::SceneStatistics (ErrorCode error) :
+	errorCode (error),
+	meshCount (0),
+	meshInstanceCount (0),
+	materialCount (0),
+	vertexCount (0),
+	triangleCount (0),
+	surfaceArea (0.0),
+	boundingBoxMin {
+		std::numeric_limits<double>::max (),
+		std::numeric_limits<double>::max (),
+		std::numeric_limits<double>::max ()
+	},
+	boundingBoxMax {
+		std::numeric_limits<double>::lowest (),
+		std::numeric_limits<double>::lowest (),
+		std::numeric_limits<double>::lowest ()
+	}
+{
+}
+
+bool SceneStatistics::IsSuccess () const
+{
+	return errorCode == ErrorCode::NoError;
+}
+
+bool SceneStatistics::HasBoundingBox () const
+{
+	return boundingBoxMin[0] <= boundingBoxMax[0];
+}
+
+unsigned int GetDefaultStatisticsThreadCount ()
+{
+#ifdef EMSCRIPTEN
+	return 1;
+#else
+	return std::min (std::max (1u, std::thread::hardware_concurrency ()), MaxDefaultThreadCount);
+#endif
+}
+
+SceneStatistics GetSceneStatistics (const aiScene* scene)
+{
+	return GetSceneStatistics (scene, GetDefaultStatisticsThreadCount ());
+}
+
+SceneStatistics GetSceneStatistics (const aiScene* scene, unsigned int threadCount)
+{
+	if (scene == nullptr) {
+		return SceneStatistics (ErrorCode::ImportError);
+	}
+
+	SceneStatistics statistics (ErrorCode::NoError);
+	statistics.meshCount = scene->mNumMeshes;
+	statistics.materialCount = scene->mNumMaterials;
+	if (scene->mRootNode == nullptr) {
+		return statistics;
+	}
+
+	std::vector<MeshInstance> instances;
+	CollectMeshInstances (scene, scene->mRootNode, aiMatrix4x4 (), instances);
+
+#ifdef EMSCRIPTEN
+	for (const MeshInstance& instance : instances) {
+		AddMeshInstance (instance, statistics);
+	}
+#else
+	// every worker processes every n-th mesh instance into its own statistics
+	size_t workerCount = std::max ((size_t) 1, std::min ((size_t) threadCount, instances.size ()));
+	std::vector<SceneStatistics> workerStatistics (workerCount, SceneStatistics (ErrorCode::NoError));
+	auto processInstances = [&] (size_t workerIndex) {
+		for (size_t i = workerIndex; i < instances.size (); i += workerCount) {
+			AddMeshInstance (instances[i], workerStatistics[workerIndex]);
+		}
+	};
+
+	// the first worker runs on the calling thread, and so do the workers
+	// whose thread couldn't be started
+	std::vector<std::thread> threads;
+	threads.reserve (workerCount - 1);
+	try {
+		for (size_t workerIndex = 1; workerIndex < workerCount; workerIndex++) {
+			threads.emplace_back (processInstances, workerIndex);
+		}
+	} catch (const std::system_error&) {
+	}
+	for (size_t workerIndex = threads.size () + 1; workerIndex < workerCount; workerIndex++) {
+		processInstances (workerIndex);
+	}
+	processInstances (0);
+	for (std::thread& thread : threads) {
+		thread.join ();
+	}
+	for (const SceneStatistics& partialStatistics : workerStatistics) {
+		MergeStatistics (partialStatistics, statistics);
+	}
+#endif
+
+	return statistics;
+}
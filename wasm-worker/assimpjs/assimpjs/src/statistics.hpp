@@ -0,0 +1,38 @@
+#ifndef STATISTICS_HPP
+#define STATISTICS_HPP
+
+#include <assimp/scene.h>
+
+#include "result.hpp"
+
+class SceneStatistics
+{
+public:
+	SceneStatistics ();
+	SceneStatistics (ErrorCode error);
+
+	bool				IsSuccess () const;
+	bool				HasBoundingBox () const;
+
+	ErrorCode			errorCode;
+	size_t				meshCount;
+	size_t				meshInstanceCount;
+	size_t				materialCount;
+	size_t				vertexCount;
+	size_t				triangleCount;
+	double				surfaceArea;
+	double				boundingBoxMin[3];
+	double				boundingBoxMax[3];
+};
+
+// Calculates the statistics of the scene as it's placed by the node hierarchy,
+// so the counts, the area and the bounding box include every mesh instance.
+// Polygons are counted as fan triangulated, so the scene doesn't have to be
+// triangulated by assimp first. Native builds process the mesh instances on
+// at most four threads by default, callers running their own thread pool can
+// pass the thread count, and one thread means no threads are started at all.
+unsigned int GetDefaultStatisticsThreadCount ();
+SceneStatistics GetSceneStatistics (const aiScene* scene);
+SceneStatistics GetSceneStatistics (const aiScene* scene, unsigned int threadCount);
+
+#endif
@@ -21,13 +21,19 @@ function GetTestFileLocation (fileName)
 	return path.join (__dirname, '../assimp/test/models/' + fileName);
 }
 
-function LoadModel (files)
+function CreateFileList (files)
 {
 	let fileList = new ajs.FileList ();
 	for (let i = 0; i < files.length; i++) {
 		let filePath = GetTestFileLocation (files[i]);
 		fileList.AddFile (filePath, fs.readFileSync (filePath))
 	}
+	return fileList;
+}
+
+function LoadModel (files)
+{
+	let fileList = CreateFileList (files);
 	return ajs.ConvertFileList (fileList, 'assjson');
 }
 
@@ -78,13 +84,42 @@ it ('Delay load', function () {
 	assert.deepStrictEqual (scene.materials[1].properties[4].value, [1, 1, 1]);
 });
 
+it ('Delay load cache', function () {
+	let existsCalls = [];
+	let loadCalls = [];
+	let result = ajs.ConvertFile (
+		'OBJ/cube_usemtl.obj',
+		'assjson',
+		fs.readFileSync (GetTestFileLocation ('OBJ/cube_usemtl.obj')),
+		function (fileName) {
+			existsCalls.push (fileName);
+			return fs.existsSync (GetTestFileLocation ('OBJ/' + fileName));
+		},
+		function (fileName) {
+			loadCalls.push (fileName);
+			return fs.readFileSync (GetTestFileLocation ('OBJ/' + fileName));
+		}
+	);
+	assert (result.IsSuccess ());
+	assert.equal (new Set (existsCalls).size, existsCalls.length);
+	assert.deepStrictEqual (loadCalls, ['cube_usemtl.mtl']);
+});
+
+it ('Referenced files', function () {
+	let objContent = fs.readFileSync (GetTestFileLocation ('OBJ/cube_usemtl.obj'));
+	assert.deepStrictEqual (ajs.GetReferencedFiles ('cube_usemtl.obj', objContent), ['cube_usemtl.mtl']);
+	let gltfContent = fs.readFileSync (GetTestFileLocation ('glTF2/BoxTextured-glTF/BoxTextured.gltf'));
+	let gltfReferences = ajs.GetReferencedFiles ('BoxTextured.gltf', gltfContent);
+	assert (gltfReferences.indexOf ('BoxTextured0.bin') !== -1);
+	let uriContent = new TextEncoder ().encode ('{"buffers":[{"uri":"data/Scene.bin"}],"images":[{"uri":"textures/Base%20Color.png"},{"uri":"other/base color.png"}]}');
+	assert.deepStrictEqual (ajs.GetReferencedFiles ('scene.gltf', uriContent), ['data/Scene.bin', 'textures/Base Color.png']);
+	let mtlContent = new TextEncoder ().encode ('newmtl wood\nmap_Kd textures\\Wood.png\n');
+	assert.deepStrictEqual (ajs.GetReferencedFiles ('car.mtl', mtlContent), ['textures/Wood.png']);
+});
+
 it ('glTF export', function () {
 	let files = ['OBJ/cube_usemtl.obj', 'OBJ/cube_usemtl.mtl'];
-	let fileList = new ajs.FileList ();
-	for (let i = 0; i < files.length; i++) {
-		let filePath = GetTestFileLocation (files[i]);
-		fileList.AddFile (filePath, fs.readFileSync (filePath))
-	}
+	let fileList = CreateFileList (files);
 	{
 		let result = ajs.ConvertFileList (fileList, 'gltf2');
 		assert (result.IsSuccess ());
@@ -100,6 +135,94 @@ it ('glTF export', function () {
 	}
 });
 
+it ('Read result in chunks', function () {
+	let files = ['OBJ/spider.obj', 'OBJ/spider.mtl'];
+	let fileList = CreateFileList (files);
+	let result = ajs.ConvertFileList (fileList, 'glb2');
+	assert (result.IsSuccess ());
+	let content = result.GetFile (0).GetContent ();
+	assert.equal (result.GetFileSize (0), content.length);
+
+	let chunks = [];
+	while (true) {
+		let chunk = result.ReadFileChunk (0, 1000);
+		if (chunk.length === 0) {
+			break;
+		}
+		assert (chunk.length <= 1000);
+		chunks.push (chunk);
+	}
+	assert.deepStrictEqual (Buffer.concat (chunks), Buffer.from (content));
+	assert.equal (result.GetFileSize (0), 0);
+});
+
+it ('Quantized glTF export', function () {
+	let files = ['OBJ/spider.obj', 'OBJ/spider.mtl'];
+	let fileList = CreateFileList (files);
+	let plain = ajs.ConvertFileList (fileList, 'glb2');
+	let quantized = ajs.ConvertFileList (fileList, 'glb2_quantized');
+	assert (quantized.IsSuccess ());
+	assert.equal (quantized.FileCount (), 1);
+	assert.equal (quantized.GetFile (0).GetPath (), 'result.glb');
+
+	let content = quantized.GetFile (0).GetContent ();
+	assert (content.length < plain.GetFile (0).GetContent ().length);
+	let view = new DataView (content.buffer, content.byteOffset, content.byteLength);
+	assert.equal (view.getUint32 (0, true), 0x46546C67);
+	let jsonLength = view.getUint32 (12, true);
+	let json = JSON.parse (new TextDecoder ().decode (content.subarray (20, 20 + jsonLength)));
+	assert.deepStrictEqual (json.extensionsRequired, ['KHR_mesh_quantization']);
+	assert (json.meshes.length > 0);
+});
+
+it ('Post-processing profiles', function () {
+	let files = ['OBJ/spider.obj', 'OBJ/spider.mtl'];
+	let fileList = CreateFileList (files);
+	function GetStepNames (result) {
+		let stepNames = [];
+		for (let i = 0; i < result.StepCount (); i++) {
+			stepNames.push (result.GetStepName (i));
+			assert (result.GetStepTime (i) >= 0.0);
+		}
+		return stepNames;
+	}
+	{
+		let result = ajs.ConvertFileList (fileList, 'glb2');
+		assert (result.IsSuccess ());
+		assert.deepStrictEqual (GetStepNames (result), ['import', 'gen_uv_coords', 'triangulate', 'sort_by_ptype', 'join_identical_vertices', 'export']);
+	}
+	{
+		let result = ajs.ConvertFileList (fileList, 'glb2', 'fast_preview');
+		assert (result.IsSuccess ());
+		assert.deepStrictEqual (GetStepNames (result), ['import', 'gen_uv_coords', 'triangulate', 'sort_by_ptype', 'export']);
+	}
+	{
+		let result = ajs.ConvertFileList (fileList, 'glb2', 'web_optimized');
+		assert (result.IsSuccess ());
+		assert.strictEqual (GetStepNames (result).length, 10);
+	}
+});
+
+it ('Scene statistics', function () {
+	let files = ['OBJ/spider.obj', 'OBJ/spider.mtl'];
+	let fileList = CreateFileList (files);
+	let statistics = ajs.AnalyzeFileList (fileList);
+	assert (statistics.success);
+	assert (statistics.meshCount > 0);
+	assert (statistics.meshInstanceCount >= statistics.meshCount);
+	assert (statistics.materialCount > 0);
+	assert (statistics.vertexCount > 0);
+	assert (statistics.triangleCount > 0);
+	assert (statistics.surfaceArea > 0.0);
+	for (let i = 0; i < 3; i++) {
+		assert (statistics.boundingBox.min[i] < statistics.boundingBox.max[i]);
+	}
+
+	let empty = ajs.AnalyzeFileList (new ajs.FileList ());
+	assert (!empty.success);
+	assert.strictEqual (empty.boundingBox, null);
+});
+
 it ('3D', function () {
 	assert (IsSuccess (['3D/box.uc', '3D/box_a.3d', '3D/box_d.3d']));
 });
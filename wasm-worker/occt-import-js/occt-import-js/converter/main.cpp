@@ -0,0 +1,573 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <limits>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+
+#include "importer.hpp"
+
+static const std::uint32_t GlbMagic = 0x46546C67;
+static const std::uint32_t GlbVersion = 2;
+static const std::uint32_t GlbJsonChunk = 0x4E4F534A;
+static const std::uint32_t GlbBinaryChunk = 0x004E4942;
+
+static const int GltfFloat = 5126;
+static const int GltfUnsignedInt = 5125;
+static const int GltfArrayBuffer = 34962;
+static const int GltfElementArrayBuffer = 34963;
+
+class Timer
+{
+public:
+	Timer () :
+		start (std::chrono::steady_clock::now ())
+	{
+
+	}
+
+	void Restart ()
+	{
+		start = std::chrono::steady_clock::now ();
+	}
+
+	double GetElapsedMilliseconds () const
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now () - start;
+		return elapsed.count ();
+	}
+
+private:
+	std::chrono::steady_clock::time_point start;
+};
+
+class PhaseTimer : public ImportObserver
+{
+public:
+	PhaseTimer () :
+		ImportObserver (),
+		timer (),
+		phaseTimes { 0.0, 0.0, 0.0 }
+	{
+
+	}
+
+	virtual void OnPhaseStart (ImportPhase phase) override
+	{
+		timer.Restart ();
+	}
+
+	virtual void OnPhaseEnd (ImportPhase phase) override
+	{
+		phaseTimes[(int) phase] = timer.GetElapsedMilliseconds ();
+	}
+
+	double GetPhaseTime (ImportPhase phase) const
+	{
+		return phaseTimes[(int) phase];
+	}
+
+private:
+	Timer	timer;
+	double	phaseTimes[3];
+};
+
+class Primitive
+{
+public:
+	Primitive () :
+		color (),
+		positions (),
+		normals (),
+		indices ()
+	{
+
+	}
+
+	Color						color;
+	std::vector<float>			positions;
+	std::vector<float>			normals;
+	std::vector<std::uint32_t>	indices;
+};
+
+class SceneMesh
+{
+public:
+	std::string					name;
+	std::vector<Primitive>		primitives;
+};
+
+class SceneNode
+{
+public:
+	SceneNode () :
+		name (),
+		mesh (-1),
+		transformation (),
+		children ()
+	{
+
+	}
+
+	std::string					name;
+	int							mesh;
+	Transformation				transformation;
+	std::vector<int>			children;
+};
+
+class Scene
+{
+public:
+	Scene () :
+		nodes (),
+		meshes (),
+		meshInstanceCount (0),
+		vertexCount (0),
+		triangleCount (0)
+	{
+
+	}
+
+	std::vector<SceneNode>		nodes;
+	std::vector<SceneMesh>		meshes;
+	size_t						meshInstanceCount;
+	size_t						vertexCount;
+	size_t						triangleCount;
+};
+
+class SceneCollector
+{
+public:
+	SceneCollector (Scene& scene) :
+		scene (scene),
+		geometryMeshes ()
+	{
+
+	}
+
+	int CollectNode (const NodePtr& node)
+	{
+		int nodeIndex = (int) scene.nodes.size ();
+		scene.nodes.push_back (SceneNode ());
+		scene.nodes[nodeIndex].name = node->GetName ();
+
+		if (node->IsMeshNode ()) {
+			scene.nodes[nodeIndex].transformation = node->GetTransformation ();
+			CollectMeshes (node, nodeIndex);
+		}
+
+		std::vector<NodePtr> children = node->GetChildren ();
+		for (const NodePtr& child : children) {
+			int childIndex = CollectNode (child);
+			scene.nodes[nodeIndex].children.push_back (childIndex);
+		}
+
+		return nodeIndex;
+	}
+
+private:
+	void CollectMeshes (const NodePtr& node, int nodeIndex)
+	{
+		// every mesh is placed by its own child node, so repeated parts share the same gltf mesh
+		node->EnumerateLocalMeshes ([&] (const Mesh& mesh, GeometryId geometryId, const Transformation& transformation) {
+			int meshIndex = CollectMesh (mesh, geometryId);
+			if (meshIndex == -1) {
+				return;
+			}
+			int meshNodeIndex = (int) scene.nodes.size ();
+			scene.nodes.push_back (SceneNode ());
+			scene.nodes[meshNodeIndex].name = mesh.GetName ();
+			scene.nodes[meshNodeIndex].mesh = meshIndex;
+			scene.nodes[meshNodeIndex].transformation = transformation;
+			scene.nodes[nodeIndex].children.push_back (meshNodeIndex);
+			scene.meshInstanceCount += 1;
+		});
+	}
+
+	int CollectMesh (const Mesh& mesh, GeometryId geometryId)
+	{
+		if (geometryId != 0) {
+			auto found = geometryMeshes.find (geometryId);
+			if (found != geometryMeshes.end ()) {
+				return found->second;
+			}
+		}
+
+		// adjacent faces with the same color are merged into one primitive,
+		// faces without their own color get the color of the mesh
+		SceneMesh sceneMesh;
+		sceneMesh.name = mesh.GetName ();
+		Color meshColor = mesh.GetColor ();
+		mesh.EnumerateFaces ([&] (const Face& face) {
+			Color faceColor = face.GetColor ();
+			if (!faceColor.hasValue) {
+				faceColor = meshColor;
+			}
+			bool newPrimitive = sceneMesh.primitives.empty () || sceneMesh.primitives.back ().color != faceColor;
+			if (newPrimitive) {
+				sceneMesh.primitives.push_back (Primitive ());
+				sceneMesh.primitives.back ().color = faceColor;
+			}
+
+			Primitive& primitive = sceneMesh.primitives.back ();
+			size_t positionCount = primitive.positions.size ();
+			size_t normalCount = primitive.normals.size ();
+			size_t indexCount = primitive.indices.size ();
+			std::uint32_t vertexOffset = (std::uint32_t) (positionCount / 3);
+			face.EnumerateVertices ([&] (double x, double y, double z) {
+				primitive.positions.push_back ((float) x);
+				primitive.positions.push_back ((float) y);
+				primitive.positions.push_back ((float) z);
+			});
+			face.EnumerateNormals ([&] (double x, double y, double z) {
+				primitive.normals.push_back ((float) x);
+				primitive.normals.push_back ((float) y);
+				primitive.normals.push_back ((float) z);
+			});
+			face.EnumerateTriangles ([&] (int v0, int v1, int v2) {
+				primitive.indices.push_back (vertexOffset + v0);
+				primitive.indices.push_back (vertexOffset + v1);
+				primitive.indices.push_back (vertexOffset + v2);
+			});
+
+			// faces without triangles shouldn't split the merged primitives
+			if (primitive.indices.size () == indexCount) {
+				if (newPrimitive) {
+					sceneMesh.primitives.pop_back ();
+				} else {
+					primitive.positions.resize (positionCount);
+					primitive.normals.resize (normalCount);
+				}
+			}
+		});
+
+		int meshIndex = -1;
+		if (!sceneMesh.primitives.empty ()) {
+			for (Primitive& primitive : sceneMesh.primitives) {
+				if (primitive.normals.size () != primitive.positions.size ()) {
+					primitive.normals.clear ();
+				}
+				scene.vertexCount += primitive.positions.size () / 3;
+				scene.triangleCount += primitive.indices.size () / 3;
+			}
+			meshIndex = (int) scene.meshes.size ();
+			scene.meshes.push_back (std::move (sceneMesh));
+		}
+		if (geometryId != 0) {
+			geometryMeshes.insert ({ geometryId, meshIndex });
+		}
+		return meshIndex;
+	}
+
+	Scene&									scene;
+	std::unordered_map<GeometryId, int>		geometryMeshes;
+};
+
+static std::string EscapeJsonString (const std::string& str)
+{
+	std::ostringstream escaped;
+	for (char c : str) {
+		switch (c) {
+			case '"':
+				escaped << "\\\"";
+				break;
+			case '\\':
+				escaped << "\\\\";
+				break;
+			case '\n':
+				escaped << "\\n";
+				break;
+			case '\r':
+				escaped << "\\r";
+				break;
+			case '\t':
+				escaped << "\\t";
+				break;
+			default:
+				if ((unsigned char) c < 0x20) {
+					escaped << "\\u" << std::hex << std::setw (4) << std::setfill ('0') << (int) c << std::dec;
+				} else {
+					escaped << c;
+				}
+				break;
+		}
+	}
+	return escaped.str ();
+}
+
+class GlbWriter
+{
+public:
+	GlbWriter (const Scene& scene) :
+		scene (scene),
+		json (),
+		binary (),
+		bufferViewCount (0),
+		accessorCount (0),
+		bufferViewsJson (),
+		accessorsJson (),
+		materials (),
+		materialColors ()
+	{
+		json << std::setprecision (std::numeric_limits<float>::max_digits10);
+		bufferViewsJson << std::setprecision (std::numeric_limits<float>::max_digits10);
+		accessorsJson << std::setprecision (std::numeric_limits<float>::max_digits10);
+	}
+
+	bool Write (const std::string& filePath)
+	{
+		std::ostringstream meshesJson;
+		meshesJson << std::setprecision (std::numeric_limits<float>::max_digits10);
+		for (size_t meshIndex = 0; meshIndex < scene.meshes.size (); meshIndex++) {
+			const SceneMesh& mesh = scene.meshes[meshIndex];
+			meshesJson << (meshIndex > 0 ? "," : "") << "{\"name\":\"" << EscapeJsonString (mesh.name) << "\",\"primitives\":[";
+			for (size_t primitiveIndex = 0; primitiveIndex < mesh.primitives.size (); primitiveIndex++) {
+				const Primitive& primitive = mesh.primitives[primitiveIndex];
+				int positionAccessor = AddVertexAccessor (primitive.positions, true);
+				meshesJson << (primitiveIndex > 0 ? "," : "") << "{\"attributes\":{\"POSITION\":" << positionAccessor;
+				if (!primitive.normals.empty ()) {
+					meshesJson << ",\"NORMAL\":" << AddVertexAccessor (primitive.normals, false);
+				}
+				meshesJson << "},\"indices\":" << AddIndexAccessor (primitive.indices);
+				if (primitive.color.hasValue) {
+					meshesJson << ",\"material\":" << GetMaterialIndex (primitive.color);
+				}
+				meshesJson << "}";
+			}
+			meshesJson << "]}";
+		}
+
+		json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"occt-import-js\"},";
+		json << "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],";
+		json << "\"nodes\":[";
+		for (size_t nodeIndex = 0; nodeIndex < scene.nodes.size (); nodeIndex++) {
+			WriteNode (scene.nodes[nodeIndex], nodeIndex > 0);
+		}
+		json << "]";
+		if (!scene.meshes.empty ()) {
+			json << ",\"meshes\":[" << meshesJson.str () << "]";
+			json << ",\"accessors\":[" << accessorsJson.str () << "]";
+			json << ",\"bufferViews\":[" << bufferViewsJson.str () << "]";
+			json << ",\"buffers\":[{\"byteLength\":" << binary.size () << "}]";
+		}
+		if (!materialColors.empty ()) {
+			WriteMaterials ();
+		}
+		json << "}";
+
+		return WriteGlb (filePath);
+	}
+
+private:
+	void WriteNode (const SceneNode& node, bool separator)
+	{
+		json << (separator ? "," : "") << "{\"name\":\"" << EscapeJsonString (node.name) << "\"";
+		if (node.mesh != -1) {
+			json << ",\"mesh\":" << node.mesh;
+		}
+		if (!node.transformation.IsIdentity ()) {
+			json << ",\"matrix\":[";
+			for (int col = 0; col < 4; col++) {
+				for (int row = 0; row < 3; row++) {
+					json << node.transformation.matrix[row][col] << ",";
+				}
+				json << (col == 3 ? "1" : "0,");
+			}
+			json << "]";
+		}
+		if (!node.children.empty ()) {
+			json << ",\"children\":[";
+			for (size_t i = 0; i < node.children.size (); i++) {
+				json << (i > 0 ? "," : "") << node.children[i];
+			}
+			json << "]";
+		}
+		json << "}";
+	}
+
+	void WriteMaterials ()
+	{
+		json << ",\"materials\":[";
+		for (size_t i = 0; i < materialColors.size (); i++) {
+			const Color& color = materialColors[i];
+			json << (i > 0 ? "," : "") << "{\"pbrMetallicRoughness\":{\"baseColorFactor\":[";
+			json << color.r << "," << color.g << "," << color.b << ",1],";
+			json << "\"metallicFactor\":0}}";
+		}
+		json << "]";
+	}
+
+	int GetMaterialIndex (const Color& color)
+	{
+		std::tuple<double, double, double> key (color.r, color.g, color.b);
+		auto found = materials.find (key);
+		if (found != materials.end ()) {
+			return found->second;
+		}
+		int materialIndex = (int) materialColors.size ();
+		materials.insert ({ key, materialIndex });
+		materialColors.push_back (color);
+		return materialIndex;
+	}
+
+	int AddBufferView (const void* data, size_t byteLength, int target)
+	{
+		size_t byteOffset = binary.size ();
+		binary.resize (byteOffset + byteLength);
+		std::memcpy (binary.data () + byteOffset, data, byteLength);
+
+		bufferViewsJson << (bufferViewCount > 0 ? "," : "");
+		bufferViewsJson << "{\"buffer\":0,\"byteOffset\":" << byteOffset << ",\"byteLength\":" << byteLength << ",\"target\":" << target << "}";
+		return bufferViewCount++;
+	}
+
+	int AddVertexAccessor (const std::vector<float>& values, bool writeBounds)
+	{
+		int bufferView = AddBufferView (values.data (), values.size () * sizeof (float), GltfArrayBuffer);
+		accessorsJson << (accessorCount > 0 ? "," : "");
+		accessorsJson << "{\"bufferView\":" << bufferView << ",\"componentType\":" << GltfFloat;
+		accessorsJson << ",\"count\":" << values.size () / 3 << ",\"type\":\"VEC3\"";
+		if (writeBounds) {
+			float min[3] = { values[0], values[1], values[2] };
+			float max[3] = { values[0], values[1], values[2] };
+			for (size_t i = 0; i < values.size (); i++) {
+				min[i % 3] = std::min (min[i % 3], values[i]);
+				max[i % 3] = std::max (max[i % 3], values[i]);
+			}
+			accessorsJson << ",\"min\":[" << min[0] << "," << min[1] << "," << min[2] << "]";
+			accessorsJson << ",\"max\":[" << max[0] << "," << max[1] << "," << max[2] << "]";
+		}
+		accessorsJson << "}";
+		return accessorCount++;
+	}
+
+	int AddIndexAccessor (const std::vector<std::uint32_t>& indices)
+	{
+		int bufferView = AddBufferView (indices.data (), indices.size () * sizeof (std::uint32_t), GltfElementArrayBuffer);
+		accessorsJson << (accessorCount > 0 ? "," : "");
+		accessorsJson << "{\"bufferView\":" << bufferView << ",\"componentType\":" << GltfUnsignedInt;
+		accessorsJson << ",\"count\":" << indices.size () << ",\"type\":\"SCALAR\"}";
+		return accessorCount++;
+	}
+
+	bool WriteGlb (const std::string& filePath)
+	{
+		// glb chunks have to be aligned to four bytes, json is padded with spaces
+		std::string jsonChunk = json.str ();
+		while (jsonChunk.size () % 4 != 0) {
+			jsonChunk.push_back (' ');
+		}
+		while (binary.size () % 4 != 0) {
+			binary.push_back (0);
+		}
+
+		std::uint32_t totalLength = 12 + 8 + (std::uint32_t) jsonChunk.size ();
+		if (!binary.empty ()) {
+			totalLength += 8 + (std::uint32_t) binary.size ();
+		}
+
+		std::ofstream glbFile (filePath, std::ios::binary);
+		if (!glbFile.is_open ()) {
+			return false;
+		}
+
+		WriteUInt32 (glbFile, GlbMagic);
+		WriteUInt32 (glbFile, GlbVersion);
+		WriteUInt32 (glbFile, totalLength);
+
+		WriteUInt32 (glbFile, (std::uint32_t) jsonChunk.size ());
+		WriteUInt32 (glbFile, GlbJsonChunk);
+		glbFile.write (jsonChunk.data (), jsonChunk.size ());
+
+		if (!binary.empty ()) {
+			WriteUInt32 (glbFile, (std::uint32_t) binary.size ());
+			WriteUInt32 (glbFile, GlbBinaryChunk);
+			glbFile.write ((const char*) binary.data (), binary.size ());
+		}
+
+		return glbFile.good ();
+	}
+
+	static void WriteUInt32 (std::ofstream& stream, std::uint32_t value)
+	{
+		// glb is little endian just like all of our target platforms
+		stream.write ((const char*) &value, sizeof (value));
+	}
+
+	const Scene&										scene;
+	std::ostringstream									json;
+	std::vector<std::uint8_t>							binary;
+	int													bufferViewCount;
+	int													accessorCount;
+	std::ostringstream									bufferViewsJson;
+	std::ostringstream									accessorsJson;
+	std::map<std::tuple<double, double, double>, int>	materials;
+	std::vector<Color>									materialColors;
+};
+
+static void PrintPhaseTime (const char* phaseName, double milliseconds)
+{
+	std::cout << std::left << std::setw (12) << phaseName << std::right << std::setw (12) << milliseconds << " ms\n";
+}
+
+static void PrintCount (const char* countName, size_t count)
+{
+	std::cout << std::left << std::setw (12) << countName << std::right << std::setw (12) << count << "\n";
+}
+
+int main (int argc, const char* argv[])
+{
+	if (argc < 3) {
+		std::cout << "usage: OcctImportJSConverter <input.stp> <output.glb>\n";
+		return 1;
+	}
+
+	Timer totalTimer;
+
+	PhaseTimer phaseTimer;
+	Importer importer;
+	importer.SetObserver (&phaseTimer);
+	Importer::Result result = importer.LoadStepFile (argv[1]);
+	if (result == Importer::Result::FileNotFound) {
+		std::cout << "file not found: " << argv[1] << "\n";
+		return 1;
+	} else if (result != Importer::Result::Success) {
+		std::cout << "import failed: " << argv[1] << "\n";
+		return 1;
+	}
+
+	Timer stepTimer;
+	Scene scene;
+	SceneCollector collector (scene);
+	collector.CollectNode (importer.GetRootNode ());
+	double enumerateTime = stepTimer.GetElapsedMilliseconds ();
+
+	stepTimer.Restart ();
+	GlbWriter writer (scene);
+	if (!writer.Write (argv[2])) {
+		std::cout << "failed to write: " << argv[2] << "\n";
+		return 1;
+	}
+	double writeTime = stepTimer.GetElapsedMilliseconds ();
+
+	std::cout << std::fixed << std::setprecision (1);
+	PrintPhaseTime ("read", phaseTimer.GetPhaseTime (ImportPhase::Read));
+	PrintPhaseTime ("transfer", phaseTimer.GetPhaseTime (ImportPhase::Transfer));
+	PrintPhaseTime ("tessellate", phaseTimer.GetPhaseTime (ImportPhase::Tessellate));
+	PrintPhaseTime ("enumerate", enumerateTime);
+	PrintPhaseTime ("write", writeTime);
+	PrintPhaseTime ("total", totalTimer.GetElapsedMilliseconds ());
+	PrintCount ("nodes", scene.nodes.size ());
+	PrintCount ("meshes", scene.meshes.size ());
+	PrintCount ("instances", scene.meshInstanceCount);
+	PrintCount ("vertices", scene.vertexCount);
+	PrintCount ("triangles", scene.triangleCount);
+
+	return 0;
+}
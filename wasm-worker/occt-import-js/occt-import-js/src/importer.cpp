@@ -5,7 +5,11 @@
 #include <TopoDS_Face.hxx>
 #include <BRep_Tool.hxx>
 #include <BRepBndLib.hxx>
+#include <BRepTools.hxx>
 #include <BRepMesh_IncrementalMesh.hxx>
+#include <IMeshTools_Parameters.hxx>
+#include <Message_ProgressIndicator.hxx>
+#include <Message_ProgressScope.hxx>
 
 #include <STEPConstruct.hxx>
 #include <STEPConstruct_Styles.hxx>
@@ -22,6 +26,8 @@
 #include <XCAFDoc_DocumentTool.hxx>
 #include <XCAFDoc_ShapeTool.hxx>
 #include <STEPCAFControl_Reader.hxx>
+#include <NCollection_DataMap.hxx>
+#include <TopTools_ShapeMapHasher.hxx>
 
 #include <iostream>
 #include <fstream>
@@ -46,7 +52,7 @@ static bool IsFreeShape (const TDF_Label& label, const Handle (XCAFDoc_ShapeTool
 	return shapeTool->GetShape (label, tmpShape) && shapeTool->IsFree (label);
 }
 
-static bool TriangulateShape (TopoDS_Shape& shape)
+static bool GetShapeDeflection (const TopoDS_Shape& shape, Standard_Real& deflection)
 {
 	Bnd_Box boundingBox;
 	BRepBndLib::Add (shape, boundingBox, false);
@@ -57,12 +63,28 @@ static bool TriangulateShape (TopoDS_Shape& shape)
 	Standard_Real xMin, yMin, zMin, xMax, yMax, zMax;
 	boundingBox.Get (xMin, yMin, zMin, xMax, yMax, zMax);
 	Standard_Real avgSize = ((xMax - xMin) + (yMax - yMin) + (zMax - zMin)) / 3.0;
-	Standard_Real linDeflection = avgSize / 1000.0;
-	Standard_Real angDeflection = 0.5;
-	BRepMesh_IncrementalMesh mesh (shape, linDeflection, Standard_False, angDeflection);
+	deflection = avgSize / 1000.0;
 	return true;
 }
 
+static void TriangulateShape (const TopoDS_Shape& shape, Standard_Real deflection, const Message_ProgressRange& progress)
+{
+	IMeshTools_Parameters meshParameters;
+	meshParameters.Deflection = deflection;
+	meshParameters.Angle = 0.5;
+	meshParameters.Relative = Standard_False;
+	BRepMesh_IncrementalMesh mesh (shape, meshParameters, progress);
+}
+
+static Standard_Integer CountFaces (const TopoDS_Shape& shape)
+{
+	Standard_Integer faceCount = 0;
+	for (TopExp_Explorer ex (shape, TopAbs_FACE); ex.More (); ex.Next ()) {
+		faceCount += 1;
+	}
+	return faceCount;
+}
+
 static std::string GetShapeName (const TopoDS_Shape& shape, const Handle(XCAFDoc_ShapeTool)& shapeTool)
 {
 	TDF_Label shapeLabel;
@@ -72,21 +94,36 @@ static std::string GetShapeName (const TopoDS_Shape& shape, const Handle(XCAFDoc
 	return GetLabelName (shapeLabel);
 }
 
-static Color GetShapeColor (const TopoDS_Shape& shape, const Handle(XCAFDoc_ColorTool)& colorTool)
+static Color GetLabelColor (const TDF_Label& label, const Handle(XCAFDoc_ColorTool)& colorTool)
 {
 	Quantity_Color color;
-	if (colorTool->GetColor (shape, XCAFDoc_ColorSurf, color)) {
+	if (colorTool->GetColor (label, XCAFDoc_ColorSurf, color)) {
 		return Color (color.Red (), color.Green (), color.Blue ());
 	}
-	if (colorTool->GetColor (shape, XCAFDoc_ColorCurv, color)) {
+	if (colorTool->GetColor (label, XCAFDoc_ColorCurv, color)) {
 		return Color (color.Red (), color.Green (), color.Blue ());
 	}
-	if (colorTool->GetColor (shape, XCAFDoc_ColorGen, color)) {
+	if (colorTool->GetColor (label, XCAFDoc_ColorGen, color)) {
 		return Color (color.Red (), color.Green (), color.Blue ());
 	}
 	return Color ();
 }
 
+static Transformation GetLocationTransformation (const TopLoc_Location& location)
+{
+	Transformation transformation;
+	if (location.IsIdentity ()) {
+		return transformation;
+	}
+	gp_Trsf trsf = location.Transformation ();
+	for (int row = 0; row < 3; row++) {
+		for (int col = 0; col < 4; col++) {
+			transformation.matrix[row][col] = trsf.Value (row + 1, col + 1);
+		}
+	}
+	return transformation;
+}
+
 Color::Color () :
 	hasValue (false),
 	r (0),
@@ -105,6 +142,40 @@ Color::Color (double r, double g, double b) :
 
 }
 
+bool Color::operator== (const Color& other) const
+{
+	if (hasValue != other.hasValue) {
+		return false;
+	}
+	return !hasValue || (r == other.r && g == other.g && b == other.b);
+}
+
+bool Color::operator!= (const Color& other) const
+{
+	return !operator== (other);
+}
+
+Transformation::Transformation ()
+{
+	for (int row = 0; row < 3; row++) {
+		for (int col = 0; col < 4; col++) {
+			matrix[row][col] = (row == col ? 1.0 : 0.0);
+		}
+	}
+}
+
+bool Transformation::IsIdentity () const
+{
+	for (int row = 0; row < 3; row++) {
+		for (int col = 0; col < 4; col++) {
+			if (matrix[row][col] != (row == col ? 1.0 : 0.0)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
 class VectorBuffer : public std::streambuf
 {
 public:
@@ -119,16 +190,172 @@ public:
 	}
 };
 
+class ImportProgressIndicator : public Message_ProgressIndicator
+{
+public:
+	ImportProgressIndicator (ImportObserver* observer, ImportPhase phase) :
+		Message_ProgressIndicator (),
+		observer (observer),
+		phase (phase),
+		lastPosition (0.0)
+	{
+
+	}
+
+	virtual Standard_Boolean UserBreak () override
+	{
+		return observer->IsCancelled ();
+	}
+
+	virtual void Show (const Message_ProgressScope& scope, const Standard_Boolean isForce) override
+	{
+		// occt shows the progress on every step, report only whole percents
+		Standard_Real position = GetPosition ();
+		if (!isForce && position - lastPosition < 0.01) {
+			return;
+		}
+		lastPosition = position;
+		observer->OnProgress (phase, position);
+	}
+
+private:
+	ImportObserver*		observer;
+	ImportPhase			phase;
+	Standard_Real		lastPosition;
+};
+
+class DeferredTessellator
+{
+public:
+	DeferredTessellator () :
+		observer (nullptr),
+		progress (),
+		scope (),
+		cancelled (false)
+	{
+
+	}
+
+	void Start (ImportObserver* newObserver, Standard_Integer faceCount)
+	{
+		// the progress of the tessellate phase is measured by the faces tessellated so far
+		Finish ();
+		observer = newObserver;
+		cancelled = false;
+		if (observer != nullptr) {
+			progress = new ImportProgressIndicator (observer, ImportPhase::Tessellate);
+		}
+		scope.reset (new Message_ProgressScope (Message_ProgressIndicator::Start (progress), "Tessellate", (Standard_Real) faceCount));
+	}
+
+	Message_ProgressRange Next (Standard_Integer faceCount)
+	{
+		// every enumerated mesh gets its range, so the meshes that are not tessellated,
+		// because they are shared, still advance the progress when their range is closed
+		if (scope == nullptr) {
+			return Message_ProgressRange ();
+		}
+		return scope->Next ((Standard_Real) faceCount);
+	}
+
+	bool Tessellate (const TopoDS_Shape& shape, Standard_Real deflection, const Message_ProgressRange& range)
+	{
+		if (IsCancelled ()) {
+			return false;
+		}
+		TriangulateShape (shape, deflection, range);
+		return !IsCancelled ();
+	}
+
+	bool IsCancelled ()
+	{
+		if (!cancelled && observer != nullptr) {
+			cancelled = observer->IsCancelled ();
+		}
+		return cancelled;
+	}
+
+	void Finish ()
+	{
+		scope.reset ();
+		progress.Nullify ();
+	}
+
+private:
+	ImportObserver*							observer;
+	Handle(Message_ProgressIndicator)		progress;
+	std::unique_ptr<Message_ProgressScope>	scope;
+	bool									cancelled;
+};
+
+class ShapeColorMap
+{
+public:
+	ShapeColorMap () :
+		locatedColors (),
+		colors ()
+	{
+
+	}
+
+	void Build (const Handle(XCAFDoc_ShapeTool)& shapeTool, const Handle(XCAFDoc_ColorTool)& colorTool)
+	{
+		// XCAFDoc_ColorTool searches the label of the shape on every lookup, so
+		// collect the colors of all shape, component and subshape labels once
+		locatedColors.Clear ();
+		colors.Clear ();
+		for (TDF_ChildIterator it (shapeTool->Label (), Standard_True); it.More (); it.Next ()) {
+			TDF_Label label = it.Value ();
+			TopoDS_Shape shape;
+			if (!shapeTool->GetShape (label, shape)) {
+				continue;
+			}
+			Color color = GetLabelColor (label, colorTool);
+			if (!color.hasValue) {
+				continue;
+			}
+			if (!locatedColors.IsBound (shape)) {
+				locatedColors.Bind (shape, color);
+			}
+			if (shapeTool->IsReference (label)) {
+				continue;
+			}
+			TopoDS_Shape unlocatedShape = shape.Located (TopLoc_Location ());
+			if (!colors.IsBound (unlocatedShape)) {
+				colors.Bind (unlocatedShape, color);
+			}
+		}
+	}
+
+	Color GetColor (const TopoDS_Shape& shape) const
+	{
+		const Color* locatedColor = locatedColors.Seek (shape);
+		if (locatedColor != nullptr) {
+			return *locatedColor;
+		}
+		const Color* color = colors.Seek (shape.Located (TopLoc_Location ()));
+		if (color != nullptr) {
+			return *color;
+		}
+		return Color ();
+	}
+
+private:
+	NCollection_DataMap<TopoDS_Shape, Color, TopTools_ShapeMapHasher> locatedColors;
+	NCollection_DataMap<TopoDS_Shape, Color, TopTools_ShapeMapHasher> colors;
+};
+
 class OcctFace : public Face
 {
 public:
-	OcctFace (const TopoDS_Face& face, const Handle(XCAFDoc_ColorTool)& colorTool) :
+	OcctFace (const TopoDS_Face& face, const TopLoc_Location& instanceLocation, const ShapeColorMap& colorMap) :
 		Face (),
 		face (face),
-		colorTool (colorTool)
+		instanceLocation (instanceLocation),
+		colorMap (colorMap)
 	{
 		triangulation = BRep_Tool::Triangulation (face, location);
-		if (HasTriangulation ()) {
+		if (HasTriangulation () && !triangulation->HasNormals ()) {
 			triangulation->ComputeNormals ();
 		}
 	}
@@ -140,7 +367,7 @@ public:
 
 	virtual Color GetColor () const override
 	{
-		return GetShapeColor ((const TopoDS_Shape&) face, colorTool);
+		return colorMap.GetColor (face.Moved (instanceLocation));
 	}
 
 	virtual void EnumerateVertices (const std::function<void (double, double, double)>& onVertex) const override
@@ -203,7 +430,8 @@ private:
 	}
 
 	const TopoDS_Face&					face;
-	const Handle(XCAFDoc_ColorTool)&	colorTool;
+	const TopLoc_Location&				instanceLocation;
+	const ShapeColorMap&				colorMap;
 	Handle(Poly_Triangulation)			triangulation;
 	TopLoc_Location						location;
 };
@@ -211,47 +439,93 @@ private:
 class OcctFacesMesh : public Mesh
 {
 public:
-	OcctFacesMesh (const TopoDS_Shape& shape, const Handle(XCAFDoc_ShapeTool)& shapeTool, const Handle(XCAFDoc_ColorTool)& colorTool) :
+	OcctFacesMesh (const TopoDS_Shape& shape, const TopLoc_Location& instanceLocation, Standard_Real deferredDeflection, DeferredTessellator& tessellator, const Handle(XCAFDoc_ShapeTool)& shapeTool, const ShapeColorMap& colorMap) :
 		Mesh (),
 		shape (shape),
+		instanceLocation (instanceLocation),
+		deferredDeflection (deferredDeflection),
+		tessellator (tessellator),
 		shapeTool (shapeTool),
-		colorTool (colorTool)
+		colorMap (colorMap),
+		progress (deferredDeflection > 0.0 ? tessellator.Next (CountFaces (shape)) : Message_ProgressRange ())
 	{
 
 	}
 
 	virtual std::string GetName () const override
 	{
-		return GetShapeName (shape, shapeTool);
+		return GetShapeName (shape.Moved (instanceLocation), shapeTool);
 	}
 
 	virtual Color GetColor () const override
 	{
-		return GetShapeColor (shape, colorTool);
+		return colorMap.GetColor (shape.Moved (instanceLocation));
+	}
+
+	GeometryId GetGeometryId () const
+	{
+		// the mesh is written with the name and colors of its occurrence, so it can be shared
+		// only if they are the same as the prototype's, reversed occurrences are not shared
+		// to keep the triangle orientation
+		if (shape.Orientation () == TopAbs_REVERSED) {
+			return 0;
+		}
+		if (!instanceLocation.IsIdentity ()) {
+			TopoDS_Shape instanceShape = shape.Moved (instanceLocation);
+			if (GetShapeName (instanceShape, shapeTool) != GetShapeName (shape, shapeTool)) {
+				return 0;
+			}
+			if (colorMap.GetColor (instanceShape) != colorMap.GetColor (shape)) {
+				return 0;
+			}
+			for (TopExp_Explorer ex (shape, TopAbs_FACE); ex.More (); ex.Next ()) {
+				const TopoDS_Shape& face = ex.Current ();
+				if (colorMap.GetColor (face.Moved (instanceLocation)) != colorMap.GetColor (face)) {
+					return 0;
+				}
+			}
+		}
+		return (GeometryId) shape.TShape ().get ();
 	}
 
 	virtual void EnumerateFaces (const std::function<void (const Face& face)>& onFace) const override
 	{
+		// with deferred tessellation the triangulation lives only while the faces are enumerated
+		if (deferredDeflection > 0.0 && !tessellator.Tessellate (shape, deferredDeflection, progress)) {
+			BRepTools::Clean (shape);
+			return;
+		}
 		for (TopExp_Explorer ex (shape, TopAbs_FACE); ex.More (); ex.Next ()) {
 			const TopoDS_Face& face = TopoDS::Face (ex.Current ());
-			OcctFace outputFace (face, colorTool);
+			OcctFace outputFace (face, instanceLocation, colorMap);
 			onFace (outputFace);
 		}
+		if (deferredDeflection > 0.0) {
+			BRepTools::Clean (shape);
+		}
 	}
 
 private:
 	const TopoDS_Shape& shape;
+	const TopLoc_Location& instanceLocation;
+	Standard_Real deferredDeflection;
+	DeferredTessellator& tessellator;
 	const Handle(XCAFDoc_ShapeTool)& shapeTool;
-	const Handle(XCAFDoc_ColorTool)& colorTool;
+	const ShapeColorMap& colorMap;
+	Message_ProgressRange progress;
 };
 
 class OcctStandaloneFacesMesh : public Mesh
 {
 public:
-	OcctStandaloneFacesMesh (const TopoDS_Shape& shape, const Handle(XCAFDoc_ColorTool)& colorTool) :
+	OcctStandaloneFacesMesh (const TopoDS_Shape& shape, const TopLoc_Location& instanceLocation, Standard_Real deferredDeflection, DeferredTessellator& tessellator, const ShapeColorMap& colorMap) :
 		Mesh (),
 		shape (shape),
-		colorTool (colorTool)
+		instanceLocation (instanceLocation),
+		deferredDeflection (deferredDeflection),
+		tessellator (tessellator),
+		colorMap (colorMap),
+		progress (deferredDeflection > 0.0 ? tessellator.Next (GetFaceCount ()) : Message_ProgressRange ())
 	{
 
 	}
@@ -262,6 +536,15 @@ public:
 		return ex.More ();
 	}
 
+	Standard_Integer GetFaceCount () const
+	{
+		Standard_Integer faceCount = 0;
+		for (TopExp_Explorer ex (shape, TopAbs_FACE, TopAbs_SHELL); ex.More (); ex.Next ()) {
+			faceCount += 1;
+		}
+		return faceCount;
+	}
+
 	virtual std::string GetName () const override
 	{
 		return std::string ();
@@ -274,25 +557,39 @@ public:
 
 	virtual void EnumerateFaces (const std::function<void (const Face& face)>& onFace) const override
 	{
+		Message_ProgressScope facesScope (progress, "Tessellate", (Standard_Real) GetFaceCount ());
 		for (TopExp_Explorer ex (shape, TopAbs_FACE, TopAbs_SHELL); ex.More (); ex.Next ()) {
 			const TopoDS_Face& face = TopoDS::Face (ex.Current ());
-			OcctFace outputFace (face, colorTool);
+			if (deferredDeflection > 0.0 && !tessellator.Tessellate (face, deferredDeflection, facesScope.Next ())) {
+				BRepTools::Clean (face);
+				return;
+			}
+			OcctFace outputFace (face, instanceLocation, colorMap);
 			onFace (outputFace);
+			if (deferredDeflection > 0.0) {
+				BRepTools::Clean (face);
+			}
 		}
 	}
 
 private:
 	const TopoDS_Shape& shape;
-	const Handle(XCAFDoc_ColorTool)& colorTool;
+	const TopLoc_Location& instanceLocation;
+	Standard_Real deferredDeflection;
+	DeferredTessellator& tessellator;
+	const ShapeColorMap& colorMap;
+	Message_ProgressRange progress;
 };
 
 class DocNode : public Node
 {
 public:
-	DocNode (const TDF_Label& label, const Handle (XCAFDoc_ShapeTool)& shapeTool, const Handle (XCAFDoc_ColorTool)& colorTool) :
+	DocNode (const TDF_Label& label, Standard_Real deferredDeflection, DeferredTessellator& tessellator, const Handle (XCAFDoc_ShapeTool)& shapeTool, const ShapeColorMap& colorMap) :
 		label (label),
+		deferredDeflection (deferredDeflection),
+		tessellator (tessellator),
 		shapeTool (shapeTool),
-		colorTool (colorTool)
+		colorMap (colorMap)
 	{
 
 	}
@@ -313,7 +610,7 @@ public:
 			TDF_Label childLabel = it.Value ();
 			if (IsFreeShape (childLabel, shapeTool)) {
 				children.push_back (std::make_shared<const DocNode> (
-					childLabel, shapeTool, colorTool
+					childLabel, deferredDeflection, tessellator, shapeTool, colorMap
 				));
 			}
 		}
@@ -363,44 +660,101 @@ public:
 		}
 
 		TopoDS_Shape shape = shapeTool->GetShape (label);
-		EnumerateShapeMeshes (shape, onMesh);
+		TopLoc_Location instanceLocation;
+		EnumerateSolidsAndShells (shape, [&] (const TopoDS_Shape& currentShape) {
+			OcctFacesMesh outputShapeMesh (currentShape, instanceLocation, deferredDeflection, tessellator, shapeTool, colorMap);
+			onMesh (outputShapeMesh);
+		});
+
+		// Create a mesh from faces that are not part of a shell
+		OcctStandaloneFacesMesh standaloneFacesMesh (shape, instanceLocation, deferredDeflection, tessellator, colorMap);
+		if (standaloneFacesMesh.HasFaces () && !IsCancelled ()) {
+			onMesh (standaloneFacesMesh);
+		}
+	}
+
+	virtual Transformation GetTransformation () const override
+	{
+		TopoDS_Shape shape = shapeTool->GetShape (label);
+		return GetLocationTransformation (shape.Location ());
+	}
+
+	virtual void EnumerateLocalMeshes (const std::function<void (const Mesh&, GeometryId, const Transformation&)>& onMesh) const override
+	{
+		if (!IsMeshNode ()) {
+			return;
+		}
+
+		// every solid and shell is written in its own coordinate system, so the parts repeated
+		// inside the node are shared as well, while the name and the colors are still looked
+		// up on the located occurrence
+		TopoDS_Shape shape = shapeTool->GetShape (label);
+		TopoDS_Shape localShape = shape.Located (TopLoc_Location ());
+		EnumerateSolidsAndShells (localShape, [&] (const TopoDS_Shape& currentShape) {
+			TopoDS_Shape meshShape = currentShape.Located (TopLoc_Location ());
+			TopLoc_Location instanceLocation = shape.Location () * currentShape.Location ();
+			OcctFacesMesh outputShapeMesh (meshShape, instanceLocation, deferredDeflection, tessellator, shapeTool, colorMap);
+			onMesh (outputShapeMesh, outputShapeMesh.GetGeometryId (), GetLocationTransformation (currentShape.Location ()));
+		});
+
+		// Create a mesh from faces that are not part of a shell
+		TopLoc_Location instanceLocation = shape.Location ();
+		OcctStandaloneFacesMesh standaloneFacesMesh (localShape, instanceLocation, deferredDeflection, tessellator, colorMap);
+		if (standaloneFacesMesh.HasFaces () && !IsCancelled ()) {
+			onMesh (standaloneFacesMesh, 0, Transformation ());
+		}
 	}
 
 private:
-	void EnumerateShapeMeshes (const TopoDS_Shape& shape, const std::function<void (const Mesh&)>& onMesh) const
+	void EnumerateSolidsAndShells (const TopoDS_Shape& shape, const std::function<void (const TopoDS_Shape&)>& onShape) const
 	{
 		// Enumerate solids
-		for (TopExp_Explorer ex (shape, TopAbs_SOLID); ex.More (); ex.Next ()) {
-			const TopoDS_Shape& currentShape = ex.Current ();
-			OcctFacesMesh outputShapeMesh (currentShape, shapeTool, colorTool);
-			onMesh (outputShapeMesh);
+		for (TopExp_Explorer ex (shape, TopAbs_SOLID); ex.More () && !IsCancelled (); ex.Next ()) {
+			onShape (ex.Current ());
 		}
 
 		// Enumerate shells that are not part of a solid
-		for (TopExp_Explorer ex (shape, TopAbs_SHELL, TopAbs_SOLID); ex.More (); ex.Next ()) {
-			const TopoDS_Shape& currentShape = ex.Current ();
-			OcctFacesMesh outputShapeMesh (currentShape, shapeTool, colorTool);
-			onMesh (outputShapeMesh);
+		for (TopExp_Explorer ex (shape, TopAbs_SHELL, TopAbs_SOLID); ex.More () && !IsCancelled (); ex.Next ()) {
+			onShape (ex.Current ());
 		}
+	}
 
-		// Create a mesh from faces that are not part of a shell
-		OcctStandaloneFacesMesh standaloneFacesMesh (shape, colorTool);
-		if (standaloneFacesMesh.HasFaces ()) {
-			onMesh (standaloneFacesMesh);
-		}
+	bool IsCancelled () const
+	{
+		// a cancelled deferred tessellation stops the enumeration between the shapes
+		return deferredDeflection > 0.0 && tessellator.IsCancelled ();
 	}
 
 	TDF_Label label;
+	Standard_Real deferredDeflection;
+	DeferredTessellator& tessellator;
 	const Handle (XCAFDoc_ShapeTool)& shapeTool;
-	const Handle (XCAFDoc_ColorTool)& colorTool;
+	const ShapeColorMap& colorMap;
+};
+
+class FreeShape
+{
+public:
+	FreeShape (const TDF_Label& label, Standard_Real deflection) :
+		label (label),
+		deflection (deflection)
+	{
+
+	}
+
+	TDF_Label label;
+	Standard_Real deflection;
 };
 
 class RootNode : public Node
 {
 public:
-	RootNode (const Handle (XCAFDoc_ShapeTool)& shapeTool, const Handle (XCAFDoc_ColorTool)& colorTool) :
+	RootNode (const std::vector<FreeShape>& freeShapes, bool deferredTessellation, DeferredTessellator& tessellator, const Handle (XCAFDoc_ShapeTool)& shapeTool, const ShapeColorMap& colorMap) :
+		freeShapes (freeShapes),
+		deferredTessellation (deferredTessellation),
+		tessellator (tessellator),
 		shapeTool (shapeTool),
-		colorTool (colorTool)
+		colorMap (colorMap)
 	{
 
 	}
@@ -412,22 +766,13 @@ public:
 
 	virtual std::vector<NodePtr> GetChildren () const override
 	{
-		TDF_Label mainLabel = shapeTool->Label ();
-
 		std::vector<NodePtr> children;
-		for (TDF_ChildIterator it (mainLabel); it.More (); it.Next ()) {
-			TDF_Label childLabel = it.Value ();
-			if (IsFreeShape (childLabel, shapeTool)) {
-				TopoDS_Shape shape = shapeTool->GetShape (childLabel);
-				if (!TriangulateShape (shape)) {
-					continue;
-				}
-				children.push_back (std::make_shared<const DocNode> (
-					childLabel, shapeTool, colorTool
-				));
-			}
+		for (const FreeShape& freeShape : freeShapes) {
+			Standard_Real deferredDeflection = (deferredTessellation ? freeShape.deflection : 0.0);
+			children.push_back (std::make_shared<const DocNode> (
+				freeShape.label, deferredDeflection, tessellator, shapeTool, colorMap
+			));
 		}
-
 		return children;
 	}
 
@@ -441,20 +786,48 @@ public:
 
 	}
 
+	virtual Transformation GetTransformation () const override
+	{
+		return Transformation ();
+	}
+
+	virtual void EnumerateLocalMeshes (const std::function<void (const Mesh&, GeometryId, const Transformation&)>& onMesh) const override
+	{
+
+	}
+
 private:
+	const std::vector<FreeShape>& freeShapes;
+	bool deferredTessellation;
+	DeferredTessellator& tessellator;
 	const Handle (XCAFDoc_ShapeTool)& shapeTool;
-	const Handle (XCAFDoc_ColorTool)& colorTool;
+	const ShapeColorMap& colorMap;
 };
 
 class ImporterImpl
 {
 public:
 	ImporterImpl () :
+		observer (nullptr),
+		tessellationMode (Importer::TessellationMode::Upfront),
 		document (nullptr),
 		shapeTool (nullptr),
-		colorTool (nullptr)
+		colorTool (nullptr),
+		colorMap (),
+		freeShapes (),
+		deferredTessellator ()
+	{
+
+	}
+
+	void SetObserver (ImportObserver* newObserver)
 	{
+		observer = newObserver;
+	}
 
+	void SetTessellationMode (Importer::TessellationMode newTessellationMode)
+	{
+		tessellationMode = newTessellationMode;
 	}
 
 	Importer::Result LoadStepFile (const std::string& filePath)
@@ -481,21 +854,37 @@ public:
 		stepCafReader.SetColorMode (true);
 		stepCafReader.SetNameMode (true);
 
+		freeShapes.clear ();
+
 		STEPControl_Reader& stepReader = stepCafReader.ChangeReader ();
 		std::string dummyFileName = "stp";
- 		IFSelect_ReturnStatus readStatus = stepReader.ReadStream (dummyFileName.c_str (), inputStream);
+		// reading the stream doesn't support progress, so it can be cancelled only after it finished
+		OnPhaseStart (ImportPhase::Read);
+		IFSelect_ReturnStatus readStatus = stepReader.ReadStream (dummyFileName.c_str (), inputStream);
+		OnPhaseEnd (ImportPhase::Read);
+		if (IsCancelled ()) {
+			return Importer::Result::Cancelled;
+		}
 		if (readStatus != IFSelect_RetDone) {
 			return Importer::Result::ImportFailed;
 		}
 
 		document = new TDocStd_Document ("XmlXCAF");
-		if (!stepCafReader.Transfer (document)) {
+		OnPhaseStart (ImportPhase::Transfer);
+		Handle(Message_ProgressIndicator) transferProgress = CreateProgressIndicator (ImportPhase::Transfer);
+		bool transferSucceeded = stepCafReader.Transfer (document, Message_ProgressIndicator::Start (transferProgress));
+		OnPhaseEnd (ImportPhase::Transfer);
+		if (IsCancelled ()) {
+			return Importer::Result::Cancelled;
+		}
+		if (!transferSucceeded) {
 			return Importer::Result::ImportFailed;
 		}
 
 		TDF_Label mainLabel = document->Main ();
 		shapeTool = XCAFDoc_DocumentTool::ShapeTool (mainLabel);
 		colorTool = XCAFDoc_DocumentTool::ColorTool (mainLabel);
+		colorMap.Build (shapeTool, colorTool);
 
 		TDF_LabelSequence labels;
 		shapeTool->GetFreeShapes (labels);
@@ -503,12 +892,64 @@ public:
 			return Importer::Result::ImportFailed;
 		}
 
+		for (TDF_ChildIterator it (shapeTool->Label ()); it.More (); it.Next ()) {
+			TDF_Label childLabel = it.Value ();
+			if (IsFreeShape (childLabel, shapeTool)) {
+				TopoDS_Shape shape = shapeTool->GetShape (childLabel);
+				Standard_Real deflection = 0.0;
+				if (GetShapeDeflection (shape, deflection)) {
+					freeShapes.push_back (FreeShape (childLabel, deflection));
+				}
+			}
+		}
+
+		// deferred shapes are tessellated solid by solid during the enumeration,
+		// so the tessellate phase lasts until FinishTessellation is called
+		if (tessellationMode == Importer::TessellationMode::Deferred) {
+			Standard_Integer faceCount = 0;
+			for (const FreeShape& freeShape : freeShapes) {
+				faceCount += CountFaces (shapeTool->GetShape (freeShape.label));
+			}
+			OnPhaseStart (ImportPhase::Tessellate);
+			deferredTessellator.Start (observer, faceCount);
+			return Importer::Result::Success;
+		}
+
+		OnPhaseStart (ImportPhase::Tessellate);
+		Handle(Message_ProgressIndicator) tessellateProgress = CreateProgressIndicator (ImportPhase::Tessellate);
+		Message_ProgressScope tessellateScope (Message_ProgressIndicator::Start (tessellateProgress), "Tessellate", (Standard_Real) freeShapes.size ());
+		for (const FreeShape& freeShape : freeShapes) {
+			if (!tessellateScope.More ()) {
+				break;
+			}
+			TopoDS_Shape shape = shapeTool->GetShape (freeShape.label);
+			TriangulateShape (shape, freeShape.deflection, tessellateScope.Next ());
+		}
+		OnPhaseEnd (ImportPhase::Tessellate);
+		if (IsCancelled ()) {
+			freeShapes.clear ();
+			return Importer::Result::Cancelled;
+		}
+
+		return Importer::Result::Success;
+	}
+
+	Importer::Result FinishTessellation ()
+	{
+		if (tessellationMode != Importer::TessellationMode::Deferred) {
+			return Importer::Result::Success;
+		}
+		deferredTessellator.Finish ();
+		OnPhaseEnd (ImportPhase::Tessellate);
+		if (deferredTessellator.IsCancelled ()) {
+			return Importer::Result::Cancelled;
+		}
 		return Importer::Result::Success;
 	}
 
-	NodePtr GetRootNode () const
+	NodePtr GetRootNode ()
 	{
-		return std::make_shared<const RootNode> (shapeTool, colorTool);
+		return std::make_shared<const RootNode> (freeShapes, tessellationMode == Importer::TessellationMode::Deferred, deferredTessellator, shapeTool, colorMap);
 	}
 
 	void DumpHierarchy ()
@@ -545,11 +986,73 @@ public:
 	}
 
 private:
+	void OnPhaseStart (ImportPhase phase)
+	{
+		if (observer != nullptr) {
+			observer->OnPhaseStart (phase);
+		}
+	}
+
+	void OnPhaseEnd (ImportPhase phase)
+	{
+		if (observer != nullptr) {
+			observer->OnPhaseEnd (phase);
+		}
+	}
+
+	bool IsCancelled () const
+	{
+		return observer != nullptr && observer->IsCancelled ();
+	}
+
+	Handle(Message_ProgressIndicator) CreateProgressIndicator (ImportPhase phase) const
+	{
+		if (observer == nullptr) {
+			return Handle(Message_ProgressIndicator) ();
+		}
+		return new ImportProgressIndicator (observer, phase);
+	}
+
+	ImportObserver* observer;
+	Importer::TessellationMode tessellationMode;
 	Handle(TDocStd_Document) document;
 	Handle(XCAFDoc_ShapeTool) shapeTool;
 	Handle(XCAFDoc_ColorTool) colorTool;
+	ShapeColorMap colorMap;
+	std::vector<FreeShape> freeShapes;
+	DeferredTessellator deferredTessellator;
 };
 
+ImportObserver::ImportObserver ()
+{
+
+}
+
+ImportObserver::~ImportObserver ()
+{
+
+}
+
+void ImportObserver::OnPhaseStart (ImportPhase phase)
+{
+
+}
+
+void ImportObserver::OnPhaseEnd (ImportPhase phase)
+{
+
+}
+
+void ImportObserver::OnProgress (ImportPhase phase, double progress)
+{
+
+}
+
+bool ImportObserver::IsCancelled () const
+{
+	return false;
+}
+
 Importer::Importer () :
 	impl (new ImporterImpl ())
 {
@@ -561,6 +1064,16 @@ Importer::~Importer ()
 	delete impl;
 }
 
+void Importer::SetObserver (ImportObserver* observer)
+{
+	impl->SetObserver (observer);
+}
+
+void Importer::SetTessellationMode (TessellationMode tessellationMode)
+{
+	impl->SetTessellationMode (tessellationMode);
+}
+
 Importer::Result Importer::LoadStepFile (const std::string& filePath)
 {
 	return impl->LoadStepFile (filePath);
@@ -576,6 +1089,11 @@ Importer::Result Importer::LoadStepFile (const std::vector<std::uint8_t>& fileCo
 	return impl->LoadStepFile (fileContent);
 }
 
+Importer::Result Importer::FinishTessellation ()
+{
+	return impl->FinishTessellation ();
+}
+
 NodePtr Importer::GetRootNode () const
 {
 	return impl->GetRootNode ();
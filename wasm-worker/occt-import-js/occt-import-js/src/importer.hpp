@@ -5,6 +5,7 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include <cstdint>
 
 class Color
 {
@@ -12,12 +13,25 @@ public:
 	Color ();
 	Color (double r, double g, double b);
 
+	bool operator== (const Color& other) const;
+	bool operator!= (const Color& other) const;
+
 	bool hasValue;
 	double r;
 	double g;
 	double b;
 };
 
+class Transformation
+{
+public:
+	Transformation ();
+
+	bool IsIdentity () const;
+
+	double matrix[3][4];
+};
+
 class Face
 {
 public:
@@ -39,6 +53,7 @@ public:
 
 class Node;
 using NodePtr = std::shared_ptr<const Node>;
+using GeometryId = std::uintptr_t;
 
 class Node
 {
@@ -48,6 +63,11 @@ public:
 
 	virtual bool IsMeshNode () const = 0;
 	virtual void EnumerateMeshes (const std::function<void (const Mesh&)>& onMesh) const = 0;
+
+	// local meshes are placed by their transformation relative to the node, and
+	// meshes with the same non-zero geometry id are the same, so they can be written once
+	virtual Transformation GetTransformation () const = 0;
+	virtual void EnumerateLocalMeshes (const std::function<void (const Mesh&, GeometryId, const Transformation&)>& onMesh) const = 0;
 };
 
 enum class Result
@@ -57,6 +77,25 @@ enum class Result
 	ImportFailed = 2
 };
 
+enum class ImportPhase
+{
+	Read = 0,
+	Transfer = 1,
+	Tessellate = 2
+};
+
+class ImportObserver
+{
+public:
+	ImportObserver ();
+	virtual ~ImportObserver ();
+
+	virtual void	OnPhaseStart (ImportPhase phase);
+	virtual void	OnPhaseEnd (ImportPhase phase);
+	virtual void	OnProgress (ImportPhase phase, double progress);
+	virtual bool	IsCancelled () const;
+};
+
 class ImporterImpl;
 
 class Importer
@@ -66,16 +105,32 @@ public:
 	{
 		Success = 0,
 		FileNotFound = 1,
-		ImportFailed = 2
+		ImportFailed = 2,
+		Cancelled = 3
+	};
+
+	enum class TessellationMode
+	{
+		// all shapes are tessellated by LoadStepFile
+		Upfront = 0,
+		// shapes are tessellated while their faces are enumerated, and the
+		// triangulation is released right after, to keep peak memory low,
+		// the tessellate phase lasts until FinishTessellation is called
+		Deferred = 1
 	};
 
 	Importer ();
 	~Importer ();
 
+	void		SetObserver (ImportObserver* observer);
+	void		SetTessellationMode (TessellationMode tessellationMode);
+
 	Result		LoadStepFile (const std::string& filePath);
 	Result		LoadStepFile (const std::vector<std::uint8_t>& fileContent);
 	Result		LoadStepFile (std::istream& inputStream);
 
+	Result		FinishTessellation ();
+
 	NodePtr		GetRootNode () const;
 	void		DumpHierarchy () const;
 
@@ -4,12 +4,17 @@
 #include "importer.hpp"
 #include <emscripten/bind.h>
 
+#include <unordered_map>
+
 class HierarchyWriter
 {
 public:
-	HierarchyWriter (emscripten::val& meshesArr) :
+	HierarchyWriter (emscripten::val& meshesArr, const emscripten::val& onMesh, bool instancing) :
 		meshesArr (meshesArr),
-		meshCount (0)
+		onMesh (onMesh),
+		meshCount (0),
+		instancing (instancing),
+		geometryMeshes ()
 	{
 	}
 
@@ -18,7 +23,11 @@ public:
 		nodeObj.set ("name", node->GetName ());
 		
 		emscripten::val nodeMeshesArr (emscripten::val::array ());
-		WriteMeshes (node, nodeMeshesArr);
+		if (instancing) {
+			WriteInstancedMeshes (node, nodeObj, nodeMeshesArr);
+		} else {
+			WriteMeshes (node, nodeMeshesArr);
+		}
 		nodeObj.set ("meshes", nodeMeshesArr);
 
 		std::vector<NodePtr> children = node->GetChildren ();
@@ -40,95 +49,240 @@ public:
 
 		int nodeMeshCount = 0;
 		node->EnumerateMeshes ([&] (const Mesh& mesh) {
-			int vertexCount = 0;
-			int normalCount = 0;
-			int triangleCount = 0;
-			int faceColorCount = 0;
-
-			emscripten::val positionArr (emscripten::val::array ());
-			emscripten::val normalArr (emscripten::val::array ());
-			emscripten::val indexArr (emscripten::val::array ());
-			emscripten::val faceColorArr (emscripten::val::array ());
-
-			mesh.EnumerateFaces ([&] (const Face& face) {
-				int triangleOffset = triangleCount;
-				int vertexOffset = vertexCount;
-				face.EnumerateVertices ([&](double x, double y, double z) {
-					positionArr.set (vertexCount * 3, x);
-					positionArr.set (vertexCount * 3 + 1, y);
-					positionArr.set (vertexCount * 3 + 2, z);
-					vertexCount += 1;
-				});
-				face.EnumerateNormals ([&](double x, double y, double z) {
-					normalArr.set (normalCount * 3, x);
-					normalArr.set (normalCount * 3 + 1, y);
-					normalArr.set (normalCount * 3 + 2, z);
-					normalCount += 1;
-				});
-				face.EnumerateTriangles ([&](int v0, int v1, int v2) {
-					indexArr.set (triangleCount * 3, vertexOffset + v0);
-					indexArr.set (triangleCount * 3 + 1, vertexOffset + v1);
-					indexArr.set (triangleCount * 3 + 2, vertexOffset + v2);
-					triangleCount += 1;
-				});
-				Color faceColor = face.GetColor ();
-				if (faceColor.hasValue) {
-					emscripten::val faceColorObj (emscripten::val::object ());
-					faceColorObj.set ("first", triangleOffset);
-					faceColorObj.set ("last", triangleCount - 1);
-					emscripten::val colorArr (emscripten::val::array ());
-					colorArr.set (0, faceColor.r);
-					colorArr.set (1, faceColor.g);
-					colorArr.set (2, faceColor.b);
-					faceColorObj.set ("color", colorArr);
-					faceColorArr.set (faceColorCount, faceColorObj);
-					faceColorCount += 1;
-				}
-			});
+			nodeMeshesArr.set (nodeMeshCount, WriteMesh (mesh));
+			nodeMeshCount += 1;
+		});
+	}
+
+	void WriteInstancedMeshes (const NodePtr& node, emscripten::val& nodeObj, emscripten::val& nodeMeshesArr)
+	{
+		if (!node->IsMeshNode ()) {
+			return;
+		}
+
+		nodeObj.set ("matrix", WriteTransformation (node->GetTransformation ()));
 
-			emscripten::val meshObj (emscripten::val::object ());
-			meshObj.set ("name", mesh.GetName ());
+		emscripten::val meshMatricesArr (emscripten::val::array ());
+		int nodeMeshCount = 0;
+		node->EnumerateLocalMeshes ([&] (const Mesh& mesh, GeometryId geometryId, const Transformation& transformation) {
+			nodeMeshesArr.set (nodeMeshCount, WriteSharedMesh (mesh, geometryId));
+			meshMatricesArr.set (nodeMeshCount, WriteTransformation (transformation));
+			nodeMeshCount += 1;
+		});
+		nodeObj.set ("mesh_matrices", meshMatricesArr);
+	}
+
+	int WriteSharedMesh (const Mesh& mesh, GeometryId geometryId)
+	{
+		if (geometryId == 0) {
+			return WriteMesh (mesh);
+		}
+
+		auto found = geometryMeshes.find (geometryId);
+		if (found != geometryMeshes.end ()) {
+			return found->second;
+		}
 
-			Color color = mesh.GetColor ();
-			if (color.hasValue) {
-				emscripten::val colorArr (emscripten::val::array ());
-				colorArr.set (0, color.r);
-				colorArr.set (1, color.g);
-				colorArr.set (2, color.b);
-				meshObj.set ("color", colorArr);
+		int meshIndex = WriteMesh (mesh);
+		geometryMeshes.insert ({ geometryId, meshIndex });
+		return meshIndex;
+	}
+
+	int WriteMesh (const Mesh& mesh)
+	{
+		int vertexCount = 0;
+		int normalCount = 0;
+		int triangleCount = 0;
+		int faceColorCount = 0;
+
+		emscripten::val positionArr (emscripten::val::array ());
+		emscripten::val normalArr (emscripten::val::array ());
+		emscripten::val indexArr (emscripten::val::array ());
+		emscripten::val faceColorArr (emscripten::val::array ());
+
+		// adjacent faces with the same color are merged into one triangle range
+		Color runColor;
+		int runFirst = 0;
+		auto writeFaceColorRun = [&] () {
+			if (!runColor.hasValue || runFirst == triangleCount) {
+				return;
 			}
+			emscripten::val faceColorObj (emscripten::val::object ());
+			faceColorObj.set ("first", runFirst);
+			faceColorObj.set ("last", triangleCount - 1);
+			emscripten::val colorArr (emscripten::val::array ());
+			colorArr.set (0, runColor.r);
+			colorArr.set (1, runColor.g);
+			colorArr.set (2, runColor.b);
+			faceColorObj.set ("color", colorArr);
+			faceColorArr.set (faceColorCount, faceColorObj);
+			faceColorCount += 1;
+		};
 
-			if (faceColorCount > 0) {
-				meshObj.set ("face_colors", faceColorArr);
+		mesh.EnumerateFaces ([&] (const Face& face) {
+			Color faceColor = face.GetColor ();
+			if (faceColor != runColor) {
+				writeFaceColorRun ();
+				runColor = faceColor;
+				runFirst = triangleCount;
 			}
 
-			emscripten::val attributesObj (emscripten::val::object ());
+			int vertexOffset = vertexCount;
+			face.EnumerateVertices ([&](double x, double y, double z) {
+				positionArr.set (vertexCount * 3, x);
+				positionArr.set (vertexCount * 3 + 1, y);
+				positionArr.set (vertexCount * 3 + 2, z);
+				vertexCount += 1;
+			});
+			face.EnumerateNormals ([&](double x, double y, double z) {
+				normalArr.set (normalCount * 3, x);
+				normalArr.set (normalCount * 3 + 1, y);
+				normalArr.set (normalCount * 3 + 2, z);
+				normalCount += 1;
+			});
+			face.EnumerateTriangles ([&](int v0, int v1, int v2) {
+				indexArr.set (triangleCount * 3, vertexOffset + v0);
+				indexArr.set (triangleCount * 3 + 1, vertexOffset + v1);
+				indexArr.set (triangleCount * 3 + 2, vertexOffset + v2);
+				triangleCount += 1;
+			});
+		});
+		writeFaceColorRun ();
+
+		emscripten::val meshObj (emscripten::val::object ());
+		meshObj.set ("name", mesh.GetName ());
+
+		Color color = mesh.GetColor ();
+		if (color.hasValue) {
+			emscripten::val colorArr (emscripten::val::array ());
+			colorArr.set (0, color.r);
+			colorArr.set (1, color.g);
+			colorArr.set (2, color.b);
+			meshObj.set ("color", colorArr);
+		}
+
+		if (faceColorCount > 0) {
+			meshObj.set ("face_colors", faceColorArr);
+		}
+
+		emscripten::val attributesObj (emscripten::val::object ());
 
-			emscripten::val positionObj (emscripten::val::object ());
-			positionObj.set ("array", positionArr);
-			attributesObj.set ("position", positionObj);
+		emscripten::val positionObj (emscripten::val::object ());
+		positionObj.set ("array", positionArr);
+		attributesObj.set ("position", positionObj);
 
-			if (vertexCount == normalCount) {
-				emscripten::val normalObj (emscripten::val::object ());
-				normalObj.set ("array", normalArr);
-				attributesObj.set ("normal", normalObj);
+		if (vertexCount == normalCount) {
+			emscripten::val normalObj (emscripten::val::object ());
+			normalObj.set ("array", normalArr);
+			attributesObj.set ("normal", normalObj);
+		}
+
+		emscripten::val indexObj (emscripten::val::object ());
+		indexObj.set ("array", indexArr);
+
+		meshObj.set ("attributes", attributesObj);
+		meshObj.set ("index", indexObj);
+
+		int meshIndex = meshCount;
+		if (onMesh.isUndefined () || onMesh.isNull ()) {
+			meshesArr.set (meshIndex, meshObj);
+		} else {
+			onMesh (meshObj, meshIndex);
+		}
+		meshCount += 1;
+		return meshIndex;
+	}
+
+	static emscripten::val WriteTransformation (const Transformation& transformation)
+	{
+		// column-major 4x4 matrix, compatible with three.js Matrix4.fromArray
+		emscripten::val matrixArr (emscripten::val::array ());
+		for (int col = 0; col < 4; col++) {
+			for (int row = 0; row < 3; row++) {
+				matrixArr.set (col * 4 + row, transformation.matrix[row][col]);
 			}
+			matrixArr.set (col * 4 + 3, col == 3 ? 1.0 : 0.0);
+		}
+		return matrixArr;
+	}
 
-			emscripten::val indexObj (emscripten::val::object ());
-			indexObj.set ("array", indexArr);
+	emscripten::val&									meshesArr;
+	emscripten::val										onMesh;
+	int													meshCount;
+	bool												instancing;
+	std::unordered_map<GeometryId, int>					geometryMeshes;
+};
 
-			meshObj.set ("attributes", attributesObj);
-			meshObj.set ("index", indexObj);
+static emscripten::val GetParam (const emscripten::val& params, const char* name)
+{
+	if (params.isUndefined () || params.isNull ()) {
+		return emscripten::val::undefined ();
+	}
+	return params[name];
+}
 
-			meshesArr.set (meshCount, meshObj);
-			nodeMeshesArr.set (nodeMeshCount, meshCount);
-			meshCount += 1;
-			nodeMeshCount += 1;
-		});
+static bool GetBoolParam (const emscripten::val& params, const char* name)
+{
+	emscripten::val param = GetParam (params, name);
+	if (param.isUndefined () || param.isNull ()) {
+		return false;
+	}
+	return param.as<bool> ();
+}
+
+class ImportObserverEmscripten : public ImportObserver
+{
+public:
+	ImportObserverEmscripten (const emscripten::val& params) :
+		ImportObserver (),
+		onProgress (GetParam (params, "onProgress")),
+		isCancelled (GetParam (params, "isCancelled"))
+	{
+
+	}
+
+	virtual void OnPhaseStart (ImportPhase phase) override
+	{
+		OnProgress (phase, 0.0);
+	}
+
+	virtual void OnPhaseEnd (ImportPhase phase) override
+	{
+		OnProgress (phase, 1.0);
+	}
+
+	virtual void OnProgress (ImportPhase phase, double progress) override
+	{
+		if (onProgress.isUndefined () || onProgress.isNull ()) {
+			return;
+		}
+		onProgress (GetPhaseName (phase), progress);
+	}
+
+	virtual bool IsCancelled () const override
+	{
+		if (isCancelled.isUndefined () || isCancelled.isNull ()) {
+			return false;
+		}
+		return isCancelled ().as<bool> ();
+	}
+
+private:
+	static std::string GetPhaseName (ImportPhase phase)
+	{
+		switch (phase) {
+			case ImportPhase::Read:
+				return "read";
+			case ImportPhase::Transfer:
+				return "transfer";
+			case ImportPhase::Tessellate:
+				return "tessellate";
+		}
+		return "";
 	}
 
-	emscripten::val& meshesArr;
-	int meshCount;
+	emscripten::val onProgress;
+	emscripten::val isCancelled;
 };
 
 static void EnumerateNodeMeshes (const NodePtr& node, const std::function<void (const Mesh&)>& onMesh)
@@ -142,14 +296,30 @@ static void EnumerateNodeMeshes (const NodePtr& node, const std::function<void (
 	}
 }
 
-emscripten::val ReadStepFile (const emscripten::val& content)
+emscripten::val ReadStepFile (const emscripten::val& content, const emscripten::val& params)
 {
 	emscripten::val resultObj (emscripten::val::object ());
 	
+	// streamed meshes are tessellated one by one, and their triangulation is released after writing
+	emscripten::val onMesh = GetParam (params, "onMesh");
+	bool streaming = !onMesh.isUndefined () && !onMesh.isNull ();
+
 	Importer importer;
-	const std::vector<uint8_t>& contentArr = emscripten::vecFromJSArray<std::uint8_t> (content);
-	Importer::Result importResult = importer.LoadStepFile (contentArr);
+	ImportObserverEmscripten observer (params);
+	importer.SetObserver (&observer);
+	if (streaming) {
+		importer.SetTessellationMode (Importer::TessellationMode::Deferred);
+	}
+
+	Importer::Result importResult = Importer::Result::ImportFailed;
+	{
+		std::vector<std::uint8_t> contentArr = emscripten::vecFromJSArray<std::uint8_t> (content);
+		importResult = importer.LoadStepFile (contentArr);
+	}
 	resultObj.set ("success", importResult == Importer::Result::Success);
+	if (importResult == Importer::Result::Cancelled) {
+		resultObj.set ("cancelled", true);
+	}
 	if (importResult != Importer::Result::Success) {
 		return resultObj;
 	}
@@ -159,17 +329,30 @@ emscripten::val ReadStepFile (const emscripten::val& content)
 	emscripten::val meshesArr (emscripten::val::array ());
 	NodePtr rootNode = importer.GetRootNode ();
 
-	HierarchyWriter hierarchyWriter (meshesArr);
+	HierarchyWriter hierarchyWriter (meshesArr, onMesh, GetBoolParam (params, "instancing"));
 	hierarchyWriter.WriteNode (rootNode, rootNodeObj);
 
+	// streamed meshes are tessellated while they are written, so they can be cancelled here as well
+	if (importer.FinishTessellation () == Importer::Result::Cancelled) {
+		resultObj.set ("success", false);
+		resultObj.set ("cancelled", true);
+		return resultObj;
+	}
+
 	resultObj.set ("root", rootNodeObj);
 	resultObj.set ("meshes", meshesArr);
 	return resultObj;
 }
 
+emscripten::val ReadStepFile (const emscripten::val& content)
+{
+	return ReadStepFile (content, emscripten::val::undefined ());
+}
+
 EMSCRIPTEN_BINDINGS (assimpjs)
 {
 	emscripten::function<emscripten::val, const emscripten::val&> ("ReadStepFile", &ReadStepFile);
+	emscripten::function<emscripten::val, const emscripten::val&, const emscripten::val&> ("ReadStepFile", &ReadStepFile);
 }
 
 #endif
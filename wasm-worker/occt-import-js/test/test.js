@@ -12,10 +12,13 @@ before (async function () {
 	occt = await occtimportjs;
 });
 
-function LoadStepFile (fileUrl)
+function LoadStepFile (fileUrl, params)
 {
 	let fileContent = fs.readFileSync (fileUrl);
-	return occt.ReadStepFile (fileContent);
+	if (params === undefined) {
+		return occt.ReadStepFile (fileContent);
+	}
+	return occt.ReadStepFile (fileContent, params);
 }
 
 describe ('Step Import', function () {
@@ -99,6 +102,114 @@ it ('as1_pe_203.stp', function () {
 	});
 });
 
+it ('as1_pe_203.stp instancing', function () {
+	let reference = LoadStepFile ('./test/testfiles/cax-if/as1_pe_203.stp');
+	let result = LoadStepFile ('./test/testfiles/cax-if/as1_pe_203.stp', { instancing : true });
+	assert (result.success);
+	assert.strictEqual (result.meshes.length, 5);
+
+	let assembly = result.root.children[0];
+	let bracket1 = assembly.children[1];
+	let bracket2 = assembly.children[2];
+	let rod = assembly.children[3];
+	assert.strictEqual (bracket1.name, 'L_BRACKET_ASSEMBLY');
+	assert.strictEqual (bracket2.name, 'L_BRACKET_ASSEMBLY');
+	assert.deepStrictEqual (bracket1.meshes, [1, 2, 3, 2, 3, 2, 3]);
+	assert.deepStrictEqual (bracket2.meshes, [1, 2, 3, 2, 3, 2, 3]);
+	assert.deepStrictEqual (rod.meshes, [4, 3, 3]);
+	assert.strictEqual (bracket1.matrix.length, 16);
+	assert.notDeepStrictEqual (bracket1.matrix, bracket2.matrix);
+	assert.strictEqual (bracket1.mesh_matrices.length, 7);
+	assert.notDeepStrictEqual (bracket1.mesh_matrices[1], bracket1.mesh_matrices[3]);
+
+	let referenceAssembly = reference.root.children[0];
+	for (let i = 0; i < assembly.children.length; i++) {
+		let node = assembly.children[i];
+		let referenceNode = referenceAssembly.children[i];
+		assert.strictEqual (node.meshes.length, referenceNode.meshes.length);
+		for (let j = 0; j < node.meshes.length; j++) {
+			let mesh = result.meshes[node.meshes[j]];
+			let referenceMesh = reference.meshes[referenceNode.meshes[j]];
+			assert.strictEqual (mesh.name, referenceMesh.name);
+			assert.deepStrictEqual (mesh.color, referenceMesh.color);
+			assert.strictEqual (mesh.index.array.length, referenceMesh.index.array.length);
+		}
+	}
+});
+
+it ('as1_pe_203.stp streaming', function () {
+	let reference = LoadStepFile ('./test/testfiles/cax-if/as1_pe_203.stp');
+	let meshes = [];
+	let result = LoadStepFile ('./test/testfiles/cax-if/as1_pe_203.stp', {
+		onMesh : function (mesh, index) {
+			assert.strictEqual (index, meshes.length);
+			meshes.push (mesh);
+		}
+	});
+	assert (result.success);
+	assert.strictEqual (result.meshes.length, 0);
+	assert.deepStrictEqual (result.root, reference.root);
+	assert.strictEqual (meshes.length, reference.meshes.length);
+	for (let i = 0; i < meshes.length; i++) {
+		assert.strictEqual (meshes[i].name, reference.meshes[i].name);
+		assert.strictEqual (meshes[i].index.array.length, reference.meshes[i].index.array.length);
+	}
+});
+
+it ('progress and cancel', function () {
+	let phases = [];
+	let result = LoadStepFile ('./test/testfiles/cax-if/as1_pe_203.stp', {
+		onProgress : function (phase, progress) {
+			if (phases.indexOf (phase) === -1) {
+				phases.push (phase);
+			}
+			assert (progress >= 0.0 && progress <= 1.0);
+		}
+	});
+	assert (result.success);
+	assert.deepStrictEqual (phases, ['read', 'transfer', 'tessellate']);
+
+	let cancelled = LoadStepFile ('./test/testfiles/cax-if/as1_pe_203.stp', {
+		isCancelled : function () {
+			return true;
+		}
+	});
+	assert (!cancelled.success);
+	assert (cancelled.cancelled);
+});
+
+it ('progress and cancel with streaming', function () {
+	let phases = [];
+	let meshCount = 0;
+	let result = LoadStepFile ('./test/testfiles/cax-if/as1_pe_203.stp', {
+		onMesh : function (mesh, index) {
+			meshCount += 1;
+		},
+		onProgress : function (phase, progress) {
+			if (phases.indexOf (phase) === -1) {
+				phases.push (phase);
+			}
+			assert (progress >= 0.0 && progress <= 1.0);
+		}
+	});
+	assert (result.success);
+	assert.strictEqual (meshCount, 18);
+	assert.deepStrictEqual (phases, ['read', 'transfer', 'tessellate']);
+
+	let cancelledMeshCount = 0;
+	let cancelled = LoadStepFile ('./test/testfiles/cax-if/as1_pe_203.stp', {
+		onMesh : function (mesh, index) {
+			cancelledMeshCount += 1;
+		},
+		isCancelled : function () {
+			return cancelledMeshCount >= 2;
+		}
+	});
+	assert (!cancelled.success);
+	assert (cancelled.cancelled);
+	assert (cancelledMeshCount < 18);
+});
+
 it ('as1-oc-214.stp', function () {
 	let result = LoadStepFile ('./test/testfiles/cax-if/as1-oc-214.stp');
 	assert (result.success);
@@ -117,6 +228,31 @@ it ('io1-cm-214.stp', function () {
 	assert.strictEqual (result.meshes.length, 1);
 });
 
+it ('io1-cm-214.stp face colors', function () {
+	// the solid is yellow, and two of its faces are overridden to red
+	let result = LoadStepFile ('./test/testfiles/cax-if/io1-cm-214.stp');
+	assert (result.success);
+	let mesh = result.meshes[0];
+	assert.deepStrictEqual (mesh.color, [1.0, 1.0, 0.0]);
+	assert (mesh.face_colors !== undefined);
+	assert (mesh.face_colors.length >= 1 && mesh.face_colors.length <= 2);
+
+	let triangleCount = mesh.index.array.length / 3;
+	let previous = null;
+	for (let faceColor of mesh.face_colors) {
+		assert.deepStrictEqual (faceColor.color, [1.0, 0.0, 0.0]);
+		assert (faceColor.first <= faceColor.last);
+		assert (faceColor.last < triangleCount);
+		if (previous !== null) {
+			assert (previous.last < faceColor.first);
+			if (previous.last + 1 === faceColor.first) {
+				assert.notDeepStrictEqual (previous.color, faceColor.color);
+			}
+		}
+		previous = faceColor;
+	}
+});
+
 it ('io1-tu-203.stp', function () {
 	let result = LoadStepFile ('./test/testfiles/cax-if/io1-tu-203.stp');
 	assert (result.success);